@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "utilities.h"
+
+// a block of an arena: used bytes of data have been handed out
+struct arena_block_s {
+    arena_block *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+arena_t parse_arena = { NULL, NULL };
+
+// Return size rounded up to a multiple of the alignment of any type
+static size_t arena_round(size_t size)
+{
+    size_t align = _Alignof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+// Return a new block with room for size bytes, put first in a's blocks
+// (a's spare block, if it is big enough)
+static arena_block *arena_new_block(arena_t *a, size_t size)
+{
+    arena_block *b;
+
+    if (a->spare != NULL && a->spare->size >= size) {
+	b = a->spare;
+	a->spare = NULL;
+    } else {
+	b = (arena_block *) malloc(sizeof(arena_block) + size);
+	if (b == NULL) {
+	    bail_with_error("Cannot allocate %zu bytes for an arena!", size);
+	}
+	b->size = size;
+    }
+    b->next = a->blocks;
+    b->used = 0;
+    a->blocks = b;
+    return b;
+}
+
+// Return size bytes of memory from a, aligned for any type
+void *arena_alloc(arena_t *a, size_t size)
+{
+    size = arena_round(size);
+    arena_block *b = a->blocks;
+
+    if (size > ARENA_BLOCK_SIZE / 4) {
+	// a block of its own (so the rest of the current block is not
+	// used, but such allocations are rare)
+	b = arena_new_block(a, size);
+	b->used = size;
+	return b->data;
+    }
+    if (b == NULL || b->size - b->used < size) {
+	b = arena_new_block(a, ARENA_BLOCK_SIZE);
+    }
+    void *ret = (char *) b->data + b->used;
+    b->used += size;
+    return ret;
+}
+
+// Requires: s != NULL
+// Return a copy of the string s allocated in a
+char *arena_strdup(arena_t *a, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *ret = (char *) arena_alloc(a, len);
+    memcpy(ret, s, len);
+    return ret;
+}
+
+// Return a mark for the memory allocated from a so far
+arena_mark_t arena_mark(arena_t *a)
+{
+    arena_mark_t m;
+    m.block = a->blocks;
+    m.used = a->blocks == NULL ? 0 : a->blocks->used;
+    return m;
+}
+
+// Free all the memory allocated from a since m was taken
+// (keeping one of the blocks freed as the spare, so that resetting
+// after each of many small jobs does not go back to the heap each time)
+void arena_reset(arena_t *a, arena_mark_t m)
+{
+    while (a->blocks != m.block) {
+	arena_block *b = a->blocks;
+	a->blocks = b->next;
+	if (b->size == ARENA_BLOCK_SIZE && a->spare == NULL) {
+	    a->spare = b;
+	} else {
+	    free(b);
+	}
+    }
+    if (m.block != NULL) {
+	m.block->used = m.used;
+    }
+}
+
+// Free all the memory allocated from a, which becomes empty
+void arena_release(arena_t *a)
+{
+    arena_block *b = a->blocks;
+    while (b != NULL) {
+	arena_block *next = b->next;
+	free(b);
+	b = next;
+    }
+    a->blocks = NULL;
+    free(a->spare);
+    a->spare = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+// Size of the blocks an arena takes from the heap
+// (larger allocations get a block of their own)
+#define ARENA_BLOCK_SIZE 65536
+
+// An arena: memory is handed out from large blocks by bumping a pointer,
+// and is only freed all at once, by arena_release,
+// or back to a mark taken earlier, by arena_reset.
+// An arena_t whose blocks are NULL is empty, and ready to use.
+typedef struct arena_block_s arena_block;
+typedef struct {
+    arena_block *blocks;  // newest first; the first is allocated from
+    arena_block *spare;   // an emptied block kept by arena_reset, or NULL
+} arena_t;
+
+// A point in the allocations of an arena, which it can be reset to
+typedef struct {
+    arena_block *block;  // the arena's first block then (NULL if none)
+    size_t used;         // the bytes of that block used then
+} arena_mark_t;
+
+// The arena for the current assembly job, which holds everything
+// parsing allocates: the ASTs and the text of tokens
+// (but not the interned identifiers, see intern.h)
+extern arena_t parse_arena;
+
+// Return size bytes of memory from a, aligned for any type.
+// Exit with an error if there is not enough memory.
+extern void *arena_alloc(arena_t *a, size_t size);
+
+// Requires: s != NULL
+// Return a copy of the string s allocated in a
+extern char *arena_strdup(arena_t *a, const char *s);
+
+// Return a mark for the memory allocated from a so far
+extern arena_mark_t arena_mark(arena_t *a);
+
+// Requires: m was returned by arena_mark(a), and a was not reset
+//           to an earlier mark or released since then
+// Free all the memory allocated from a since m was taken
+// (keeping a block for the allocations that follow)
+extern void arena_reset(arena_t *a, arena_mark_t m);
+
+// Free all the memory allocated from a, which becomes empty
+// (and can be used again)
+extern void arena_release(arena_t *a);
+
+#endif
@@ -123,6 +123,9 @@ extern void yyerror(const char *filename, const char *msg);
 %start program
 
 %code {
+ /* the list actions assemble as they go in single-pass mode */
+#include "stream.h"
+
  /* extern declarations provided by the lexer */
 extern int yylex(void);
 
@@ -157,8 +160,8 @@ lora : label { $$ = ast_lora_label($1); }
      | unsignednumsym { $$ = ast_lora_addr($1); }
      ;
 
-asmInstrs : asmInstr { $$ = ast_asm_instrs_singleton($1); }
-          | asmInstrs asmInstr { $$ = ast_asm_instrs_add($1,$2); }
+asmInstrs : asmInstr { $$ = stream_asm_instrs_singleton($1); }
+          | asmInstrs asmInstr { $$ = stream_asm_instrs_add($1,$2); }
           ;
 
 label : identsym ;
@@ -327,7 +330,7 @@ dataSection : ".data" staticStartAddr staticDecls
 staticStartAddr : unsignednumsym ;
 
 staticDecls : empty { $$ = ast_static_decls_empty($1); }
-            | staticDecls staticDecl { $$ = ast_static_decls_add($1,$2); }
+            | staticDecls staticDecl { $$ = stream_static_decls_add($1,$2); }
             ;
 
 staticDecl : dataSize identsym initializerOpt eolsym
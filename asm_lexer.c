@@ -1034,18 +1034,18 @@ extern char *strdup(const char *s);
 // set the lexer's value for a token in yylval as an AST
 static void tok2ast(int code) {
     AST t;
-    t.token.file_loc = file_location_make(filename, yylineno);
+    t.token.file_loc = lexer_location();
     t.token.type_tag = token_ast;
     t.token.code = code;
-    t.token.text = strdup(yytext);
+    t.token.text = lexer_text_copy(yytext);
     yylval = t;
 }
 
 static void reg2ast(const char *txt) {
     AST t;
-    t.reg.file_loc = file_location_make(filename, yylineno);
+    t.reg.file_loc = lexer_location();
     t.reg.type_tag = reg_ast;
-    t.reg.text = strdup(yytext);
+    t.reg.text = lexer_text_copy(yytext);
     unsigned short n;
     sscanf(txt, "%hd", &n);
     t.reg.number = n;
@@ -1054,9 +1054,9 @@ static void reg2ast(const char *txt) {
 
 static void namedreg2ast(unsigned short num, const char *txt) {
     AST t;
-    t.reg.file_loc = file_location_make(filename, yylineno);
+    t.reg.file_loc = lexer_location();
     t.reg.type_tag = reg_ast;
-    t.reg.text = strdup(yytext);
+    t.reg.text = lexer_text_copy(yytext);
     t.reg.number = num;
     yylval = t;
 }
@@ -1064,18 +1064,18 @@ static void namedreg2ast(unsigned short num, const char *txt) {
 
 static void ident2ast(const char *name) {
     AST t;
-    t.ident.file_loc = file_location_make(filename, yylineno);
+    t.ident.file_loc = lexer_location();
     t.ident.type_tag = ident_ast;
-    t.ident.name = strdup(name);
+    t.ident.name = lexer_intern(name);
     yylval = t;
 }
 
 static void unsignednum2ast(unsigned int val)
 {
     AST t;
-    t.unsignednum.file_loc = file_location_make(filename, yylineno);
+    t.unsignednum.file_loc = lexer_location();
     t.unsignednum.type_tag = unsignednum_ast;
-    t.unsignednum.text = strdup(yytext);
+    t.unsignednum.text = lexer_text_copy(yytext);
     t.unsignednum.value = val;
     yylval = t;
 }
@@ -12,6 +12,10 @@
 #include "asm_unparser.h"
 #include "pass1.h"
 #include "assemble.h"
+#include "stream.h"
+#include "arena.h"
+#include "intern.h"
+#include "file_location.h"
 
 // strdup seems to be in the string library but not in the header...
 extern char *strdup(const char *s);
@@ -19,6 +23,16 @@ extern char *strdup(const char *s);
 /* The program's AST, set by the parser */
 extern program_t progast;
 
+// Free everything parsing allocated for this assembly job
+// (the ASTs, the interned identifiers, and the file table), all at once;
+// progast must not be used after this
+static void release_parse_memory()
+{
+    intern_reset();
+    arena_release(&parse_arena);
+    file_location_reset();
+}
+
 // Requires: fn is a name that ends in .asm
 // Modify fn to have the extension .bof
 static void change_to_bof_ext(char *fn) {
@@ -41,11 +55,12 @@ char * cmdname;
 static const char *typicalFile = "file.asm";
 
 void usage() {
-    bail_with_error("Usage: %s %s\n       %s %s %s\n       %s %s %s\n       %s %s %s",
+    bail_with_error("Usage: %s %s\n       %s %s %s\n       %s %s %s\n       %s %s %s\n       %s %s %s",
 		    cmdname, typicalFile,
 		    cmdname, "-l", typicalFile,
 		    cmdname, "-u", typicalFile,
-		    cmdname, "-s", typicalFile);
+		    cmdname, "-s", typicalFile,
+		    cmdname, "-1", typicalFile);
     exit(EXIT_FAILURE);
 }
 
@@ -61,12 +76,14 @@ int main(int argc, char *argv[]) {
     bool parser_unparse = false;
     // should the symbol table be printed after pass 1?
     bool symbol_table_print = false;
+    // should the program be assembled in a single pass, as it is parsed?
+    bool single_pass = false;
 
     cmdname = argv[0];
     argc--;
     argv++;
 
-    // possible options: -l, -u, and -s
+    // possible options: -l, -u, -s, and -1
     while (argc > 0 && strlen(argv[0]) >= 2 && argv[0][0] == '-') {
 	if (strcmp(argv[0],"-l") == 0) {
 	    lexer_print_output = true;
@@ -80,6 +97,10 @@ int main(int argc, char *argv[]) {
 	    symbol_table_print = true;
 	    argc--;
 	    argv++;
+	} else if (strcmp(argv[0],"-1") == 0) {
+	    single_pass = true;
+	    argc--;
+	    argv++;
 	} else {
 	    // bad option!
 	    usage();
@@ -96,6 +117,12 @@ int main(int argc, char *argv[]) {
 	usage();
     }
 
+    // give usage message if -1 and -l or -u are used
+    // (in a single pass there is no AST to unparse)
+    if ( single_pass && (lexer_print_output || parser_unparse) ) {
+	usage();
+    }
+
     // must have a file name
     if (argc <= 0 || (strlen(argv[0]) >= 2 && argv[0][0] == '-')) {
 	usage();
@@ -112,9 +139,23 @@ int main(int argc, char *argv[]) {
     }
 
     // otherwise (if not lexer_print_outout) continue to parse etc.
+    // (in a single pass, the code is written to the .bof file
+    // as it is parsed, so that file is opened first)
+    char *bfn = NULL;
+    BOFFILE bf;
+    if (single_pass) {
+	bfn = strdup(file_name);
+	change_to_bof_ext(bfn);
+	bf = bof_write_open(bfn);
+	stream_start(bf);
+    }
     lexer_init(file_name);
     int parser_ret = yyparse(file_name);
     if (parser_ret != 0) {
+	if (single_pass) {
+	    // do not leave part of a program behind
+	    stream_abandon();
+	}
 	exit(EXIT_FAILURE);
     }
 
@@ -123,25 +164,38 @@ int main(int argc, char *argv[]) {
     }
 
     if (parser_unparse) {
+	release_parse_memory();
 	return EXIT_SUCCESS;
     }
 
     // check for duplicate declarations of labels/names and build symbol table
-    pass1(progast);
+    // (in a single pass, the parser already did this)
+    if (!single_pass) {
+	pass1(progast);
+    }
 
     // print debugging information about the symbol table
     if (symbol_table_print) {
 	pass1_print(stdout);
     }
 
-    char *bfn = strdup(file_name);
-    change_to_bof_ext(bfn);
-    
-    BOFFILE bf = bof_write_open(bfn);
+    if (!single_pass) {
+	bfn = strdup(file_name);
+	change_to_bof_ext(bfn);
+	bf = bof_write_open(bfn);
+    }
 
     // generate code from the ASTs
-    assembleProgram(bf, progast);
+    // (or, in a single pass, finish the code written while parsing)
+    if (single_pass) {
+	stream_finish(bf, progast);
+    } else {
+	assembleProgram(bf, progast);
+    }
     bof_close(bf);
+    free(bfn);
+
+    release_parse_memory();
 
     return EXIT_SUCCESS;
 }
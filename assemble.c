@@ -1,5 +1,6 @@
 /* $Id: assemble.c,v 1.10 2023/09/17 20:47:27 leavens Exp $ */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "ast.h"
 #include "utilities.h"
@@ -9,31 +10,33 @@
 #include "id_attrs.h"
 #include "regname.h"
 
-// Return the address associated with the lora l
-static address_type assemble_lora2address(lora_t l)
+// Return the address associated with the lora l,
+// exiting with an error if its label is not in the symbol table
+address_type assemble_lora2address(lora_t l)
 {
     address_type ret = l.addr;
     if (!(l.address_defined)) {
 	id_attrs *ida = symtab_lookup(l.label);
 	if (ida == NULL) {
-	    bail_with_error("Label \"%s\" was never defined!", l.label);
+	    bail_with_error("%s:%u: Label \"%s\" was never defined!",
+			    file_location_filename(l.file_loc),
+			    file_location_line(l.file_loc), l.label);
 	}
 	ret = ida->addr;
     }
     return ret;
 }
 
+
 // Assemble the code for prog, with output going to bf
 void assembleProgram(BOFFILE bf, program_t prog)
 {
     BOFHeader bh;
     strcpy(bh.magic, "BOF");
     bh.text_start_address = assemble_lora2address(prog.textSection.entryPoint);
-    bh.text_length = BYTES_PER_WORD
-	* ast_list_length(prog.textSection.instrs.instrs);
+    bh.text_length = BYTES_PER_WORD * prog.textSection.instrs.length;
     bh.data_start_address = prog.dataSection.static_start_addr;
-    bh.data_length = BYTES_PER_WORD
-	* ast_list_length(prog.dataSection.staticDecls.decls);
+    bh.data_length = BYTES_PER_WORD * prog.dataSection.staticDecls.length;
     bh.stack_bottom_addr = prog.stackSection.stack_bottom_addr;
     bof_write_header(bf, bh);
     assembleTextSection(bf, prog.textSection);
@@ -47,14 +50,37 @@ void assembleTextSection(BOFFILE bf, text_section_t ts)
     assembleAsmInstrs(bf, ts.instrs);
 }
 
+// Return a fresh array with room for length words (NULL if length is 0);
+// the caller must free the array
+static word_type *assemble_alloc_words(int length)
+{
+    if (length == 0) {
+	return NULL;
+    }
+    word_type *words = (word_type *) malloc(length * sizeof(word_type));
+    if (words == NULL) {
+	bail_with_error("Cannot allocate space for %d words of output!",
+			length);
+    }
+    return words;
+}
+
 // Assemble the code for the given AST, with output going to bf
+// (the instructions are collected and written with a single write)
 void assembleAsmInstrs(BOFFILE bf, asm_instrs_t instrs)
 {
+    int length = instrs.length;
+    word_type *words = assemble_alloc_words(length);
+    wordAsInstr_t wi;
+    int i = 0;
     asm_instr_t *ip = instrs.instrs;
     while (ip != NULL) {
-	assembleAsmInstr(bf, *ip);
+	wi.bi = assembleBinInstr(ip->instr);
+	words[i++] = wi.w;
 	ip = ip->next;
     }
+    bof_write_words(bf, words, length);
+    free(words);
 }
 
 // Assemble the code for the given AST, with output going to bf
@@ -83,7 +109,9 @@ static int immedData_value(immedData_t immed)
 	} else {
 	    id_attrs *idap = symtab_lookup(immed.data.lora.label);
 	    if (idap == NULL) {
-		bail_with_error("Label \"%s\" never defined!",
+		bail_with_error("%s:%u: Label \"%s\" never defined!",
+				file_location_filename(immed.data.lora.file_loc),
+				file_location_line(immed.data.lora.file_loc),
 				immed.data.lora.label);
 	    } else {
 		return idap->addr;
@@ -101,9 +129,11 @@ static int immedData_value(immedData_t immed)
     return ret;
 }
 
-// Assemble the code for the given AST, with output going to bf
-void assembleInstr(BOFFILE bf, instr_t instr)
+// Return the binary form of the given instruction AST,
+// exiting with an error if it uses a label not in the symbol table
+bin_instr_t assembleBinInstr(instr_t instr)
 {
+    bin_instr_t ret;
     switch (instr.itype) {
     case syscall_instr_type:
 	syscall_instr_t si;
@@ -111,7 +141,7 @@ void assembleInstr(BOFFILE bf, instr_t instr)
 	si.op = REG_O;
 	si.code = immedData_value(instr.immed_data);
 	si.func = SYSCALL_F;
-	instruction_write_syscallInstr(bf, si);
+	ret = instruction_make_syscallInstr(si);
 	break;
     case reg_instr_type:
 	reg_instr_t ri;
@@ -125,7 +155,7 @@ void assembleInstr(BOFFILE bf, instr_t instr)
 	} else {
 	    ri.shift = 0;
 	}
-	instruction_write_regInstr(bf, ri);
+	ret = instruction_make_regInstr(ri);
 	break;
     case immed_instr_type:
 	immed_instr_t ii;
@@ -133,18 +163,27 @@ void assembleInstr(BOFFILE bf, instr_t instr)
 	ii.rs = instr.regs[0];
 	ii.rt = instr.regs[1];
 	ii.immed = immedData_value(instr.immed_data);
-	instruction_write_immedInstr(bf, instr.opcode, ii);
+	ret = instruction_make_immedInstr(instr.opcode, ii);
 	break;
     case jump_instr_type:
 	jump_instr_t ji;
 	ji.op = instr.opcode;
 	ji.addr = immedData_value(instr.immed_data);
-	instruction_write_jumpInstr(bf, instr.opcode, ji);
+	ret = instruction_make_jumpInstr(instr.opcode, ji);
 	break;
     default:
 	bail_with_error("Bad instr_type in assembleInstr (%d)!", instr.itype);
 	break;
     }
+    return ret;
+}
+
+// Assemble the code for the given AST, with output going to bf
+void assembleInstr(BOFFILE bf, instr_t instr)
+{
+    wordAsInstr_t wi;
+    wi.bi = assembleBinInstr(instr);
+    bof_write_words(bf, &wi.w, 1);
 }
 
 // Assemble the code for the given AST, with output going to bf
@@ -154,13 +193,19 @@ void assembleDataSection(BOFFILE bf, data_section_t ds)
 }
 
 // Assemble the code for the given AST, with output going to bf
+// (the words are collected and written with a single write)
 void assembleStaticDecls(BOFFILE bf, static_decls_t sds)
 {
+    int length = sds.length;
+    word_type *words = assemble_alloc_words(length);
+    int i = 0;
     static_decl_t *dcl = sds.decls;
     while (dcl != NULL) {
-	assembleStaticDecl(bf, *dcl);
+	words[i++] = dcl->initializer.number;
 	dcl = dcl->next;
     }
+    bof_write_words(bf, words, length);
+    free(words);
 }
 
 // Assemble the code for the given AST, with output going to bf
@@ -8,6 +8,14 @@
 // Generate code for prog, with output going to the file out
 extern void assembleProgram(BOFFILE bf, program_t prog);
 
+// Return the address associated with the lora l,
+// exiting with an error if its label is not in the symbol table
+extern address_type assemble_lora2address(lora_t l);
+
+// Return the binary form of the given instruction AST,
+// exiting with an error if it uses a label not in the symbol table
+extern bin_instr_t assembleBinInstr(instr_t instr);
+
 // Unparse the given AST, with output going to bf
 extern void assembleTextSection(BOFFILE bf, text_section_t ts);
 
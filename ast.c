@@ -2,22 +2,23 @@
 #include <string.h>
 #include <stdlib.h>
 #include "utilities.h"
+#include "arena.h"
 #include "ast.h"
 #include "lexer.h"
 
 // Return the file location from an AST
-file_location *ast_file_loc(AST t) {
+file_location ast_file_loc(AST t) {
     return t.generic.file_loc;
 }
 
 // Return the filename from the AST t
 const char *ast_filename(AST t) {
-    return ast_file_loc(t)->filename;
+    return file_location_filename(ast_file_loc(t));
 }
 
 // Return the line number from the AST t
 unsigned int ast_line(AST t) {
-    return ast_file_loc(t)->line;
+    return file_location_line(ast_file_loc(t));
 }
 
 // Return the type tag of the AST t
@@ -26,12 +27,9 @@ AST_type ast_type_tag(AST t) {
 }
 
 // Return a pointer to a fresh copy of t
-// that has been allocated on the heap
+// that has been allocated in the parse arena
 AST *ast_heap_copy(AST t) {
-    AST *ret = (AST *)malloc(sizeof(AST));
-    if (ret == NULL) {
-	bail_with_error("Cannot allocate an AST heap copy!");
-    }
+    AST *ret = (AST *)arena_alloc(&parse_arena, sizeof(AST));
     *ret = t;
     return ret;
 }
@@ -55,7 +53,7 @@ text_section_t ast_text_section(token_t tok, lora_t entryPoint,
 				asm_instrs_t instrs)
 {
     text_section_t ret;
-    ret.file_loc = file_location_copy(tok.file_loc);
+    ret.file_loc = tok.file_loc;
     ret.type_tag = text_section_ast;
     ret.entryPoint = entryPoint;
     ret.instrs = instrs;
@@ -67,7 +65,7 @@ text_section_t ast_text_section(token_t tok, lora_t entryPoint,
 lora_t ast_lora_label(ident_t label)
 {
     lora_t ret;
-    ret.file_loc = file_location_copy(label.file_loc);
+    ret.file_loc = label.file_loc;
     ret.type_tag = lora_ast;
     ret.address_defined = false;
     ret.label = label.name;
@@ -80,7 +78,7 @@ lora_t ast_lora_label(ident_t label)
 lora_t ast_lora_addr(unsignednum_t addr)
 {
     lora_t ret;
-    ret.file_loc = file_location_copy(addr.file_loc);
+    ret.file_loc = addr.file_loc;
     ret.type_tag = lora_ast;
     ret.address_defined = true;
     ret.label = NULL;
@@ -109,13 +107,13 @@ asm_instrs_t ast_asm_instrs_singleton(asm_instr_t asminstr)
     asm_instrs_t ret;
     ret.file_loc = asminstr.file_loc;
     ret.type_tag = asm_instrs_ast;
-    asm_instr_t *p = (asm_instr_t *)malloc(sizeof(asm_instr_t));
-    if (p == NULL) {
-	bail_with_error("Cannot allocate space for an asm_instr!");
-    }
+    asm_instr_t *p = (asm_instr_t *)arena_alloc(&parse_arena,
+						sizeof(asm_instr_t));
     *p = asminstr;
     p->next = NULL;
     ret.instrs = p;
+    ret.last = p;
+    ret.length = 1;
     return ret;
 }
 
@@ -123,19 +121,18 @@ asm_instrs_t ast_asm_instrs_singleton(asm_instr_t asminstr)
 asm_instrs_t ast_asm_instrs_add(asm_instrs_t lst, asm_instr_t asminstr)
 {
     asm_instrs_t ret = lst;
-    asm_instr_t *p = (asm_instr_t *)malloc(sizeof(asm_instr_t));
-    if (p == NULL) {
-	bail_with_error("Cannot allocate space for an asm_instr!");
-    }
+    asm_instr_t *p = (asm_instr_t *)arena_alloc(&parse_arena,
+						sizeof(asm_instr_t));
     *p = asminstr;
     p->next = NULL;
     // splice p onto the end of lst.instrs
-    asm_instr_t *last = ast_last_list_elem(lst.instrs);
-    if (last == NULL) {
+    if (lst.last == NULL) {
 	ret.instrs = p;
     } else {
-	last->next = p;
+	lst.last->next = p;
     }
+    ret.last = p;
+    ret.length++;
     return ret;
 }
 
@@ -144,7 +141,7 @@ asm_instrs_t ast_asm_instrs_add(asm_instrs_t lst, asm_instr_t asminstr)
 label_opt_t ast_label_opt_label(ident_t id)
 {
     label_opt_t ret;
-    ret.file_loc = file_location_copy(id.file_loc);
+    ret.file_loc = id.file_loc;
     ret.type_tag = label_opt_ast;
     ret.name = id.name;
     return ret;
@@ -155,7 +152,7 @@ label_opt_t ast_label_opt_label(ident_t id)
 label_opt_t ast_label_opt_empty(empty_t t)
 {
     label_opt_t ret;
-    ret.file_loc = file_location_copy(t.file_loc);
+    ret.file_loc = t.file_loc;
     ret.type_tag = label_opt_ast;
     ret.name = NULL;
     return ret;
@@ -202,7 +199,7 @@ extern instr_t ast_instr(token_t op, instr_type itype,
 			 immed_kind_t ik, immedData_t im)
 {
     instr_t ret;
-    ret.file_loc = file_location_copy(op.file_loc);
+    ret.file_loc = op.file_loc;
     ret.type_tag = instr_ast;
     ret.itype = itype;
     ret.opcode = lexer_token2opcode(op.code);
@@ -223,7 +220,7 @@ data_section_t ast_data_section(token_t kw, unsigned int static_start,
 				static_decls_t staticDecls)
 {
     data_section_t ret;
-    ret.file_loc = file_location_copy(kw.file_loc);
+    ret.file_loc = kw.file_loc;
     ret.type_tag = data_section_ast;
     ret.static_start_addr = static_start;
     ret.staticDecls = staticDecls;
@@ -234,9 +231,11 @@ data_section_t ast_data_section(token_t kw, unsigned int static_start,
 static_decls_t ast_static_decls_empty(empty_t e)
 {
     static_decls_t ret;
-    ret.file_loc = file_location_copy(e.file_loc);
+    ret.file_loc = e.file_loc;
     ret.type_tag = static_decls_ast;
     ret.decls = NULL;
+    ret.last = NULL;
+    ret.length = 0;
     return ret;
 }
 
@@ -246,19 +245,18 @@ static_decls_t ast_static_decls_add(static_decls_t sds,
 				    static_decl_t sd)
 {
     static_decls_t ret = sds;
-    static_decl_t *p = (static_decl_t *)malloc(sizeof(static_decl_t));
-    if (p == NULL) {
-	bail_with_error("Cannot allocate space for a static_decl!");
-    }
+    static_decl_t *p = (static_decl_t *)arena_alloc(&parse_arena,
+						    sizeof(static_decl_t));
     *p = sd;
     p->next = NULL;
     // splice p onto the end of sds.decls
-    static_decl_t *last = ast_last_list_elem(sds.decls);
-    if (last == NULL) {
+    if (sds.last == NULL) {
 	ret.decls = p;
     } else {
-	last->next = p;
+	sds.last->next = p;
     }
+    ret.last = p;
+    ret.length++;
     return ret;
 }
 
@@ -266,13 +264,11 @@ static_decls_t ast_static_decls_add(static_decls_t sds,
 // for the given number of bytes
 data_size_t ast_data_size(token_t kw, unsigned short bytes)
 {
-    // duplicated from string.h to suppress a (silly) warning
-    extern char *strdup(const char *s);
     data_size_t ret;
-    ret.file_loc = file_location_copy(kw.file_loc);
+    ret.file_loc = kw.file_loc;
     ret.type_tag = data_size_ast;
     ret.size_in_bytes = bytes;
-    ret.size_name = strdup(kw.text);
+    ret.size_name = arena_strdup(&parse_arena, kw.text);
     return ret;
 }
 
@@ -284,7 +280,7 @@ static_decl_t ast_static_decl(data_size_t ds,
 			      initializer_t initializer)
 {
     static_decl_t ret;
-    ret.file_loc = file_location_copy(ds.file_loc);
+    ret.file_loc = ds.file_loc;
     ret.type_tag = static_decl_ast;
     ret.size_in_bytes = ds.size_in_bytes;
     ret.size_name = ds.size_name;
@@ -297,7 +293,7 @@ static_decl_t ast_static_decl(data_size_t ds,
 initializer_t ast_initializer_given(token_t eqs, word_type value)
 {
     initializer_t ret;
-    ret.file_loc = file_location_copy(eqs.file_loc);
+    ret.file_loc = eqs.file_loc;
     ret.type_tag = initializer_ast;
     ret.number = value;
     return ret;
@@ -308,7 +304,7 @@ initializer_t ast_initializer_given(token_t eqs, word_type value)
 stack_section_t ast_stack_section(token_t kw, unsigned int stack_bottom)
 {
     stack_section_t ret;
-    ret.file_loc = file_location_copy(kw.file_loc);
+    ret.file_loc = kw.file_loc;
     ret.type_tag = stack_section_ast;
     ret.stack_bottom_addr = stack_bottom;
     return ret;
@@ -318,7 +314,7 @@ stack_section_t ast_stack_section(token_t kw, unsigned int stack_bottom)
 extern initializer_t ast_initializer_empty(empty_t e)
 {
     initializer_t ret;
-    ret.file_loc = file_location_copy(e.file_loc);
+    ret.file_loc = e.file_loc;
     ret.type_tag = initializer_ast;
     ret.number = 0;
     return ret;
@@ -348,7 +344,7 @@ ident_t ast_ident(const char *fn, unsigned int ln, const char *name)
 number_t ast_number(token_t sgn, word_type value)
 {
     number_t ret;
-    ret.file_loc = file_location_copy(sgn.file_loc);
+    ret.file_loc = sgn.file_loc;
     ret.type_tag = number_ast;
     ret.value = value;
     return ret;
@@ -27,34 +27,34 @@ typedef union AST_u AST;
 // The generic struct type (generic_t) has the fields that
 // should be in all alternatives of the union AST_u
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag; // says what field of the union is active
     void *next; // for lists
 } generic_t;
 
 // empty ::=
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
 } empty_t;
 
 // label ::= ident
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
 } ident_t;
 
 // (signed) numbers (and offsets)
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     word_type value;
 } number_t;
 
 // unsigned numbers
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     unsigned int value;
@@ -62,7 +62,7 @@ typedef struct {
 
 // registers
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     unsigned short number;
@@ -70,7 +70,7 @@ typedef struct {
 
 // dataSize ::= WORD
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     unsigned short size_in_bytes;
     const char *size_name;
@@ -78,7 +78,7 @@ typedef struct {
 
 // tokens as ASTs
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     int code;
@@ -87,14 +87,14 @@ typedef struct {
 
 // label-opt ::= label | empty
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;  // NULL if there was no label
 } label_opt_t;
 
 // lora ::= label | unsigned-number
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     bool address_defined;
     const char *label; // NULL if address_defined
@@ -125,7 +125,7 @@ typedef enum {ik_immed, ik_uimmed, ik_offset, ik_syscall_code, ik_none
 //         | immed-arith-instr | immed-bool-instr | branch-test-instr
 //         | load-store-instr | jump-instr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     instr_type itype;
     const char *opname;
@@ -139,7 +139,7 @@ typedef struct {
 
 // asmInstr ::= label-opt instr
 typedef struct asm_instr_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct asm_instr_s *next;  // for lists
     label_opt_t label_opt;
@@ -147,23 +147,27 @@ typedef struct asm_instr_s {
 } asm_instr_t;
 
 // asmInstrs ::= asmInstr asmInstr*
+// (the list keeps its last element and its length,
+// so adding to its end and finding its length take constant time)
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     asm_instr_t *instrs;
+    asm_instr_t *last;
+    int length;
 } asm_instrs_t;
 
 // initializer-opt ::= initializer | empty
 // initializer ::= = number
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     word_type number;
 } initializer_t;
 
 // staticDecl ::= dataSize ident initializer-opt
 typedef struct static_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct static_decl_s *next;  // for lists
     unsigned short size_in_bytes;
@@ -173,15 +177,18 @@ typedef struct static_decl_s {
 } static_decl_t;
 
 // staticDecls ::= staticDecl*
+// (kept like asm_instrs_t, with the last element and the length)
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     static_decl_t *decls;
+    static_decl_t *last;  // NULL if decls is empty
+    int length;
 } static_decls_t;
 
 // text-section ::= entry-point asmInstr*
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     lora_t entryPoint;
     asm_instrs_t instrs;
@@ -189,7 +196,7 @@ typedef struct {
 
 // data-section ::= static-decl*
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     address_type static_start_addr;
     static_decls_t staticDecls;
@@ -197,14 +204,14 @@ typedef struct {
 
 // stack-section ::= .stack stack-bottom-addr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     address_type stack_bottom_addr;
 } stack_section_t;
 
 // program ::= text-section data-section
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     text_section_t textSection;
     data_section_t dataSection;
@@ -235,6 +242,9 @@ typedef union AST_u {
     token_t token;
 } AST;
 
+// Return the file location from an AST
+extern file_location ast_file_loc(AST t);
+
 // Return the filename from the AST t
 extern const char *ast_filename(AST t);
 
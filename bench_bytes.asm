@@ -0,0 +1,77 @@
+	# bench_bytes.asm: a benchmark of byte string processing with LBU and SB,
+	# which swaps the case of the letters in an 8192-byte string
+	# and then reverses it, 200 times (about 30 million instructions),
+	# then prints a hash of the string
+	.text start
+start:	NOTR
+	ADDI $0, $t0, 8192      # fill the string, at 8192, with printable characters
+	ADDI $0, $t1, 8192
+	ADDI $0, $t2, 32
+	SB $t0, $t2, 0
+	ADDI $t2, $t2, 7
+	ADDI $t2, $t3, -127
+	BLTZ $t3, 1
+	ADDI $t2, $t2, -95
+	ADDI $t0, $t0, 1
+	ADDI $t1, $t1, -1
+	BGTZ $t1, -8
+	ADDI $0, $s3, 200       # passes
+pass:	ADDI $0, $t0, 8192      # swap the case of each letter
+	ADDI $0, $t1, 8192
+	LBU $t0, $t2, 0
+	ADDI $t2, $t3, -97
+	BLTZ $t3, 4
+	ADDI $t2, $t3, -123
+	BGEZ $t3, 7
+	ADDI $t2, $t2, -32      # lower case to upper case
+	BEQ $0, $0, 5
+	ADDI $t2, $t3, -65
+	BLTZ $t3, 3
+	ADDI $t2, $t3, -91
+	BGEZ $t3, 1
+	ADDI $t2, $t2, 32       # upper case to lower case
+	SB $t0, $t2, 0
+	ADDI $t0, $t0, 1
+	ADDI $t1, $t1, -1
+	BGTZ $t1, -16
+	ADDI $0, $t0, 8192      # reverse the string
+	ADDI $0, $t1, 16383
+	ADDI $0, $t4, 4096
+	LBU $t0, $t2, 0
+	LBU $t1, $t3, 0
+	SB $t0, $t3, 0
+	SB $t1, $t2, 0
+	ADDI $t0, $t0, 1
+	ADDI $t1, $t1, -1
+	ADDI $t4, $t4, -1
+	BGTZ $t4, -8
+	ADDI $s3, $s3, -1
+	BGTZ $s3, -31
+	ADDI $0, $t0, 8192      # hash the string
+	ADDI $0, $t1, 8192
+	LBU $t0, $t2, 0
+	SLL $s0, $t5, 5
+	SRL $s0, $t6, 27
+	XOR $t5, $t6, $s0
+	XOR $s0, $t2, $s0
+	ADDI $t0, $t0, 1
+	ADDI $t1, $t1, -1
+	BGTZ $t1, -8
+	# print the checksum in $s0 as 8 hexadecimal digits and a newline
+	ADDI $0, $t9, 8
+	SRL $s0, $t8, 28        # next digit: the top 4 bits of $s0
+	ANDI $t8, $t8, 0xf
+	ADDI $t8, $a0, 48       # '0' + digit
+	ADDI $t8, $t7, -10
+	BLTZ $t7, 1
+	ADDI $a0, $a0, 39       # 'a' + digit - 10
+	PCH
+	SLL $s0, $s0, 4
+	ADDI $t9, $t9, -1
+	BGTZ $t9, -10
+	ADDI $0, $a0, 10
+	PCH
+	EXIT
+	.data 1024
+	.stack 4096
+	.end
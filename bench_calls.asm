@@ -0,0 +1,48 @@
+	# bench_calls.asm: a benchmark of recursive calls with JAL and JR,
+	# which computes fib(25) 10 times (about 27 million instructions)
+	# and prints the sum of the results
+	.text start
+start:	NOTR
+	ADDI $0, $s1, 10        # repetitions
+rep:	ADDI $0, $a0, 25
+	JAL fib
+	ADD $s0, $v0, $s0
+	ADDI $s1, $s1, -1
+	BGTZ $s1, -5
+	# print the checksum in $s0 as 8 hexadecimal digits and a newline
+	ADDI $0, $t9, 8
+	SRL $s0, $t8, 28        # next digit: the top 4 bits of $s0
+	ANDI $t8, $t8, 0xf
+	ADDI $t8, $a0, 48       # '0' + digit
+	ADDI $t8, $t7, -10
+	BLTZ $t7, 1
+	ADDI $a0, $a0, 39       # 'a' + digit - 10
+	PCH
+	SLL $s0, $s0, 4
+	ADDI $t9, $t9, -1
+	BGTZ $t9, -10
+	ADDI $0, $a0, 10
+	PCH
+	EXIT
+	# fib: return fib($a0) in $v0
+fib:	ADDI $a0, $t0, -2
+	BGEZ $t0, 2
+	ADD $a0, $0, $v0        # fib(n) = n, for n < 2
+	JR $ra
+	ADDI $sp, $sp, -12      # save $ra, n, and fib(n-1)
+	SW $sp, $ra, 0
+	SW $sp, $a0, 1
+	ADDI $a0, $a0, -1
+	JAL fib
+	SW $sp, $v0, 2
+	LW $sp, $a0, 1
+	ADDI $a0, $a0, -2
+	JAL fib
+	LW $sp, $t0, 2
+	ADD $v0, $t0, $v0
+	LW $sp, $ra, 0
+	ADDI $sp, $sp, 12
+	JR $ra
+	.data 1024
+	.stack 4096
+	.end
@@ -0,0 +1,38 @@
+	# bench_loop.asm: a benchmark of nested loops of ALU instructions
+	# (about 30 million instructions), which prints a checksum
+	.text start
+start:	NOTR
+	ADDI $0, $s0, 1
+	ADDI $0, $t0, 600       # outer iterations
+outer:	ADDI $0, $t1, 5000      # inner iterations
+	ADD $s0, $t1, $s1       # mix the counters into $s0
+	XOR $s1, $t0, $s1
+	SLL $s1, $t2, 3
+	SRL $s1, $t3, 5
+	XOR $t2, $t3, $t4
+	ANDI $t4, $s0, 0x7fff
+	BOR $s0, $t1, $t5
+	XOR $s2, $t5, $s2
+	ADDI $t1, $t1, -1
+	BGTZ $t1, -10
+	ADDI $t0, $t0, -1
+	BGTZ $t0, -13
+	XOR $s0, $s2, $s0
+	# print the checksum in $s0 as 8 hexadecimal digits and a newline
+	ADDI $0, $t9, 8
+	SRL $s0, $t8, 28        # next digit: the top 4 bits of $s0
+	ANDI $t8, $t8, 0xf
+	ADDI $t8, $a0, 48       # '0' + digit
+	ADDI $t8, $t7, -10
+	BLTZ $t7, 1
+	ADDI $a0, $a0, 39       # 'a' + digit - 10
+	PCH
+	SLL $s0, $s0, 4
+	ADDI $t9, $t9, -1
+	BGTZ $t9, -10
+	ADDI $0, $a0, 10
+	PCH
+	EXIT
+	.data 1024
+	.stack 4096
+	.end
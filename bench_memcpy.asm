@@ -0,0 +1,56 @@
+	# bench_memcpy.asm: a benchmark that copies a 4096-word buffer
+	# with LW and SW, 2500 times (about 30 million instructions),
+	# then prints the sum of the copy
+	.text start
+start:	NOTR
+	ADDI $0, $t0, 8192      # fill the source, at 8192, with 7, 10, 13, ...
+	ADDI $0, $t1, 4096
+	ADDI $0, $t2, 7
+	SW $t0, $t2, 0
+	ADDI $t2, $t2, 3
+	ADDI $t0, $t0, 4
+	ADDI $t1, $t1, -1
+	BGTZ $t1, -5
+	ADDI $0, $s3, 2500      # copies
+pass:	ADDI $0, $t0, 8192
+	ADDI $0, $t1, 24576     # the copy goes at 24576
+	ADDI $0, $t3, 1024      # 4 words at a time
+	LW $t0, $t4, 0
+	LW $t0, $t5, 1
+	LW $t0, $t6, 2
+	LW $t0, $t7, 3
+	SW $t1, $t4, 0
+	SW $t1, $t5, 1
+	SW $t1, $t6, 2
+	SW $t1, $t7, 3
+	ADDI $t0, $t0, 16
+	ADDI $t1, $t1, 16
+	ADDI $t3, $t3, -1
+	BGTZ $t3, -12
+	ADDI $s3, $s3, -1
+	BGTZ $s3, -17
+	ADDI $0, $t1, 24576     # sum the copy
+	ADDI $0, $t3, 4096
+	LW $t1, $t4, 0
+	ADD $s0, $t4, $s0
+	ADDI $t1, $t1, 4
+	ADDI $t3, $t3, -1
+	BGTZ $t3, -5
+	# print the checksum in $s0 as 8 hexadecimal digits and a newline
+	ADDI $0, $t9, 8
+	SRL $s0, $t8, 28        # next digit: the top 4 bits of $s0
+	ANDI $t8, $t8, 0xf
+	ADDI $t8, $a0, 48       # '0' + digit
+	ADDI $t8, $t7, -10
+	BLTZ $t7, 1
+	ADDI $a0, $a0, 39       # 'a' + digit - 10
+	PCH
+	SLL $s0, $s0, 4
+	ADDI $t9, $t9, -1
+	BGTZ $t9, -10
+	ADDI $0, $a0, 10
+	PCH
+	EXIT
+	.data 1024
+	.stack 4096
+	.end
@@ -0,0 +1,47 @@
+	# bench_muldiv.asm: a benchmark of chained MUL and DIV instructions,
+	# driven by a linear congruential generator
+	# (about 30 million instructions), which prints a checksum
+	.text start
+start:	NOTR
+	LW $gp, $s1, 0          # multiplier
+	LW $gp, $s2, 1          # increment
+	LW $gp, $t0, 2          # iterations
+	ADDI $0, $s3, 7
+	ADDI $0, $s5, 13
+	ADDI $0, $s4, 1         # x
+loop:	MUL $s4, $s1            # x = x * multiplier ^ increment
+	MFLO $t1
+	XOR $t1, $s2, $s4
+	DIV $s4, $s3
+	MFHI $t2
+	MFLO $t3
+	XOR $s0, $t2, $s0
+	MUL $t3, $s3
+	MFLO $t4
+	XOR $s0, $t4, $s0
+	DIV $t4, $s5
+	MFLO $t5
+	XOR $s0, $t5, $s0
+	ADDI $t0, $t0, -1
+	BGTZ $t0, -15
+	# print the checksum in $s0 as 8 hexadecimal digits and a newline
+	ADDI $0, $t9, 8
+	SRL $s0, $t8, 28        # next digit: the top 4 bits of $s0
+	ANDI $t8, $t8, 0xf
+	ADDI $t8, $a0, 48       # '0' + digit
+	ADDI $t8, $t7, -10
+	BLTZ $t7, 1
+	ADDI $a0, $a0, 39       # 'a' + digit - 10
+	PCH
+	SLL $s0, $s0, 4
+	ADDI $t9, $t9, -1
+	BGTZ $t9, -10
+	ADDI $0, $a0, 10
+	PCH
+	EXIT
+	.data 1024
+	WORD multiplier = 1103515245
+	WORD increment = 12345
+	WORD iterations = 2000000
+	.stack 4096
+	.end
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bof.h"
+#include "utilities.h"
+#include "bintrace.h"
+
+// Size of the stdio buffer used when writing a trace
+#define BINTRACE_BUFFER_SIZE (256 * 1024)
+
+// Open filename for writing a binary trace of the program with header bh,
+// write the trace's header, and return the open file.
+// Exit with an error if this fails.
+BOFFILE bintrace_write_open(const char *filename, BOFHeader bh) {
+    char magic[MAGIC_BUFFER_SIZE] = BINTRACE_MAGIC;
+    BOFFILE bf = bof_write_open(filename);
+
+    setvbuf(bf.fileptr, NULL, _IOFBF, BINTRACE_BUFFER_SIZE);
+    bof_write_bytes(bf, MAGIC_BUFFER_SIZE, magic);
+    bof_write_header(bf, bh);
+    return bf;
+}
+
+// Write the tag byte t
+static void bintrace_write_tag(BOFFILE bf, int t) {
+    unsigned char tag = t;
+    bof_write_bytes(bf, sizeof(tag), &tag);
+}
+
+// Start a step for the instruction instr, about to be executed at pc
+void bintrace_begin_step(BOFFILE bf, int pc, word_type instr) {
+    bof_write_word(bf, pc);
+    bof_write_word(bf, instr);
+}
+
+// Record that register reg (or BINTRACE_HI or BINTRACE_LO) now holds value
+void bintrace_reg(BOFFILE bf, int reg, word_type value) {
+    bintrace_write_tag(bf, reg);
+    bof_write_word(bf, value);
+}
+
+// Record that the memory word with the given index now holds value
+void bintrace_word(BOFFILE bf, int index, word_type value) {
+    unsigned short i = index;
+    bintrace_write_tag(bf, BINTRACE_WORD);
+    bof_write_bytes(bf, sizeof(i), &i);
+    bof_write_word(bf, value);
+}
+
+// Finish the current step
+void bintrace_end_step(BOFFILE bf) {
+    bintrace_write_tag(bf, BINTRACE_END_STEP);
+}
+
+// Read the header of the binary trace in bf and return the traced program's
+// BOFHeader. If bf is not a binary trace, exit with an error message.
+BOFHeader bintrace_read_header(BOFFILE bf) {
+    char magic[MAGIC_BUFFER_SIZE];
+
+    if (bof_read_bytes(bf, MAGIC_BUFFER_SIZE, magic) != 1
+        || strncmp(magic, BINTRACE_MAGIC, MAGIC_BUFFER_SIZE) != 0) {
+        bail_with_error("File %s is not a binary trace, bad magic number!",
+                        bf.filename);
+    }
+    return bof_read_header(bf);
+}
+
+// Read the start of the next step into *pc and *instr,
+// returning false if the trace has no more steps.
+bool bintrace_read_step(BOFFILE bf, int *pc, word_type *instr) {
+    if (bof_read_bytes(bf, sizeof(*pc), pc) != 1) {
+        return false;
+    }
+    *instr = bof_read_word(bf);
+    return true;
+}
+
+// Read the next change of the current step into *change,
+// returning false at the end of the step.
+bool bintrace_read_change(BOFFILE bf, bintrace_change *change) {
+    unsigned char tag;
+    unsigned short index;
+
+    if (bof_read_bytes(bf, sizeof(tag), &tag) != 1) {
+        bail_with_error("Binary trace %s ends in the middle of a step",
+                        bf.filename);
+    }
+    if (tag == BINTRACE_END_STEP) {
+        return false;
+    }
+    change->tag = tag;
+    change->index = 0;
+    if (tag == BINTRACE_WORD) {
+        if (bof_read_bytes(bf, sizeof(index), &index) != 1) {
+            bail_with_error("Binary trace %s ends in the middle of a step",
+                            bf.filename);
+        }
+        change->index = index;
+    } else if (tag > BINTRACE_LO) {
+        bail_with_error("Bad change tag (%d) in binary trace %s",
+                        tag, bf.filename);
+    }
+    change->value = bof_read_word(bf);
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef _BINTRACE_H
+#define _BINTRACE_H
+
+#include <stdbool.h>
+#include "bof.h"
+#include "machine_types.h"
+
+// A binary trace is a compact alternative to the VM's text trace.
+// It starts with the magic "BTR" and the BOFHeader of the traced program.
+// Each traced step follows, as PC and the instruction word, then
+// the registers and memory words that changed since the previous step
+// (or, for the first step, that are not zero), then an end marker.
+// Changes are a one byte tag followed by the new value: tags 0 to 31
+// are general purpose registers, BINTRACE_HI and BINTRACE_LO are HI and LO,
+// and BINTRACE_WORD is followed by a 16 bit word index into memory.
+// All numbers are stored in the machine's byte order, as in BOF files.
+
+#define BINTRACE_MAGIC "BTR"
+#define BINTRACE_HI 32
+#define BINTRACE_LO 33
+#define BINTRACE_WORD 34
+#define BINTRACE_END_STEP 255
+
+// One change in a step of a binary trace
+typedef struct {
+    int tag;           // register number, BINTRACE_HI, BINTRACE_LO, or BINTRACE_WORD
+    int index;         // the word index into memory, if tag is BINTRACE_WORD
+    word_type value;   // the new value
+} bintrace_change;
+
+// Open filename for writing a binary trace of the program with header bh,
+// write the trace's header, and return the open file (to be closed with
+// bof_close). Exit with an error if this fails.
+extern BOFFILE bintrace_write_open(const char *filename, BOFHeader bh);
+
+// Requires: bf was opened by bintrace_write_open
+// Start a step for the instruction instr, about to be executed at pc
+extern void bintrace_begin_step(BOFFILE bf, int pc, word_type instr);
+
+// Requires: a step has been started in bf
+// Record that register reg (or BINTRACE_HI or BINTRACE_LO) now holds value
+extern void bintrace_reg(BOFFILE bf, int reg, word_type value);
+
+// Requires: a step has been started in bf
+// Record that the memory word with the given index now holds value
+extern void bintrace_word(BOFFILE bf, int index, word_type value);
+
+// Requires: a step has been started in bf
+// Finish the current step
+extern void bintrace_end_step(BOFFILE bf);
+
+// Requires: bf is open for reading in binary
+// Read the header of the binary trace in bf and return the traced program's
+// BOFHeader. If bf is not a binary trace, exit with an error message.
+extern BOFHeader bintrace_read_header(BOFFILE bf);
+
+// Requires: bf is open for reading in binary, just after a header or a step
+// Read the start of the next step into *pc and *instr,
+// returning false if the trace has no more steps.
+extern bool bintrace_read_step(BOFFILE bf, int *pc, word_type *instr);
+
+// Requires: bf is open for reading in binary, inside a step
+// Read the next change of the current step into *change,
+// returning false at the end of the step.
+extern bool bintrace_read_change(BOFFILE bf, bintrace_change *change);
+
+#endif
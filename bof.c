@@ -2,6 +2,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "bof.h"
 #include "utilities.h"
 
@@ -48,6 +52,23 @@ size_t bof_read_bytes(BOFFILE bf, size_t bytes, void *buf) {
     return elems_read;
 }
 
+// Requires: bf is open for reading in binary and
+// dst has room for at least n words
+// Read the next n words from bf into dst, with a single read.
+// Exit the program with an error if bf has fewer than n words left.
+void bof_read_words(BOFFILE bf, word_type *dst, size_t n)
+{
+    size_t words_read;
+    if (n == 0) {
+	return;
+    }
+    words_read = fread(dst, BYTES_PER_WORD, n, bf.fileptr);
+    if (words_read != n) {
+	bail_with_error("Cannot read %zu words from %s (got %zu), the file is at EOF: %d",
+			n, bf.filename, words_read, feof(bf.fileptr));
+    }
+}
+
 // Requires: bf is open for reading in binary
 // Read the header of bf as a BOFHeader and return that header
 // If any errors are encountered, exit with an error message.
@@ -73,6 +94,76 @@ BOFHeader bof_read_header(BOFFILE bf) {
     */
 }
 
+// Map filename into memory, check its header, and set *bm to describe it.
+// Return 1 if that works.
+// Return 0 if the file cannot be mapped (e.g., it is a pipe),
+// so the caller can read it with stdio instead.
+// Return -1 if the file cannot be opened, is not a BOF file,
+// or is too short for the sections its header gives,
+// putting a message that says so in error (of size error_size).
+int bof_map_open(const char *filename, BOFMAP *bm,
+		 char *error, size_t error_size)
+{
+    struct stat st;
+    size_t text_bytes, data_bytes;
+    const char *file;
+    const char *problem = NULL;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+	snprintf(error, error_size, "Error opening file for reading: %s",
+		 filename);
+	return -1;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+	close(fd);
+	return 0;
+    }
+    bm->mapping_size = st.st_size;
+    bm->mapping = mmap(NULL, bm->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bm->mapping == MAP_FAILED) {
+	return 0;
+    }
+
+    bm->filename = filename;
+    file = (const char *) bm->mapping;
+    if (bm->mapping_size < sizeof(BOFHeader)) {
+	problem = "Cannot read header from %s";
+    } else {
+	memcpy(&bm->header, file, sizeof(BOFHeader));
+	// the sections are read as whole words, back to back after the header
+	text_bytes = (bm->header.text_length / BYTES_PER_WORD) * BYTES_PER_WORD;
+	data_bytes = (bm->header.data_length / BYTES_PER_WORD) * BYTES_PER_WORD;
+	if (strncmp(bm->header.magic, "BOF", MAGIC_BUFFER_SIZE) != 0) {
+	    problem = "File %s is not a BOF format file, bad magic number!";
+	} else if (bm->header.text_length < 0
+		   || bm->header.data_length < 0) {
+	    problem = "Negative section length in the header of %s";
+	} else if (bm->mapping_size - sizeof(BOFHeader)
+		   < text_bytes + data_bytes) {
+	    problem = "File %s is too short for the sections in its header";
+	}
+    }
+    if (problem != NULL) {
+	snprintf(error, error_size, problem, filename);
+	munmap(bm->mapping, bm->mapping_size);
+	return -1;
+    }
+    bm->text = file + sizeof(BOFHeader);
+    bm->data = file + sizeof(BOFHeader) + text_bytes;
+    return 1;
+}
+
+// Requires: bm was filled in by bof_map_open
+// Unmap the given file (its sections can no longer be used)
+void bof_map_close(BOFMAP bm)
+{
+    if (munmap(bm.mapping, bm.mapping_size) != 0) {
+	bail_with_error("Could not unmap %s", bm.filename);
+    }
+}
+
 // Open filename for writing as a binary file
 // Exit the program with an error if this fails,
 // otherwise return the BOFFILE for it.
@@ -122,6 +213,21 @@ void bof_write_bytes(BOFFILE bf, size_t bytes,
     }
 }
 
+// Requires: bf is open for writing in binary
+//           and src has at least n words
+// Write the n words starting at src into bf, with a single write.
+// Exit the program with an error if this fails.
+void bof_write_words(BOFFILE bf, const word_type *src, size_t n)
+{
+    if (n == 0) {
+	return;
+    }
+    size_t wr = fwrite(src, BYTES_PER_WORD, n, bf.fileptr);
+    if (wr != n) {
+	bail_with_error("Cannot write %zu words to %s", n, bf.filename);
+    }
+}
+
 // Requires: bf is open for writing in binary
 // Write the given header to f
 // Exit the program with an error if this fails.
@@ -139,3 +245,14 @@ void bof_write_header(BOFFILE bf, const BOFHeader hdr) {
     bof_write_bytes(bf, BYTES_PER_WORD, &hdr.stack_bottom_addr);
     */
 }
+
+// Requires: bf is open for writing in binary to a file (not a pipe)
+// Make the next write to bf go at the given byte offset from its start,
+// so what was written there can be patched.
+// Exit the program with an error if this fails.
+void bof_seek(BOFFILE bf, long offset)
+{
+    if (fseek(bf.fileptr, offset, SEEK_SET) != 0) {
+	bail_with_error("Cannot seek to byte %ld of %s", offset, bf.filename);
+    }
+}
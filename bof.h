@@ -38,11 +38,42 @@ extern word_type bof_read_word(BOFFILE bf);
 // Read the given number of bytes into buf and return the number of bytes read
 size_t bof_read_bytes(BOFFILE bf, size_t bytes, void *buf);
 
+// Requires: bf is open for reading in binary and
+// dst has room for at least n words
+// Read the next n words from bf into dst, with a single read.
+// Exit the program with an error if bf has fewer than n words left.
+extern void bof_read_words(BOFFILE bf, word_type *dst, size_t n);
+
 // Requires: bf is open for reading in binary
 // Read the header of bf as a BOFHeader and return that header
 // If any errors are encountered, exit with an error message.
 extern BOFHeader bof_read_header(BOFFILE);
 
+// a BOF file mapped into memory, for loading without stdio
+typedef struct {
+    const char *filename;
+    BOFHeader header;
+    const void *text;   // the text section's words
+    const void *data;   // the data section's words
+    void *mapping;      // the whole file (mapping_size bytes)
+    size_t mapping_size;
+} BOFMAP;
+
+// Map filename into memory, check its header, and set *bm to describe it.
+// Return 1 if that works.
+// Return 0 if the file cannot be mapped (e.g., it is a pipe),
+// so the caller can read it with stdio instead.
+// Return -1 if the file cannot be opened, is not a BOF file,
+// or is too short for the sections its header gives,
+// putting a message that says so in error (of size error_size).
+// (This does not exit, so a program can go on after a bad file.)
+extern int bof_map_open(const char *filename, BOFMAP *bm,
+			char *error, size_t error_size);
+
+// Requires: bm was filled in by bof_map_open
+// Unmap the given file (its sections can no longer be used)
+extern void bof_map_close(BOFMAP bm);
+
 // Open filename for writing as a binary file
 // Exit the program with an error if this fails,
 // otherwise return the BOFFILE for it.
@@ -67,10 +98,22 @@ extern void bof_write_word(BOFFILE bf, word_type w);
 extern void bof_write_bytes(BOFFILE bf, size_t bytes,
 			    const void *buf);
 
+// Requires: bf is open for writing in binary
+//           and src has at least n words
+// Write the n words starting at src into bf, with a single write.
+// Exit the program with an error if this fails.
+extern void bof_write_words(BOFFILE bf, const word_type *src, size_t n);
+
 // Requires: bf is open for writing in binary
 // Write the given header to f
 // Exit the program with an error if this fails.
 void bof_write_header(BOFFILE bf, const BOFHeader hdr);
+
+// Requires: bf is open for writing in binary to a file (not a pipe)
+// Make the next write to bf go at the given byte offset from its start,
+// so what was written there can be patched.
+// Exit the program with an error if this fails.
+extern void bof_seek(BOFFILE bf, long offset);
 // The following line is for the SRM manual document
 // ...
 #endif
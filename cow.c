@@ -0,0 +1,108 @@
+// for MAP_ANONYMOUS and sysconf
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "utilities.h"
+#include "cow.h"
+
+struct cow_image {
+    FILE *file;      // an unlinked temporary file that holds the bytes
+    size_t size;     // bytes in the image, a whole number of pages
+};
+
+// Return the size of a page on this host
+static size_t cow_page_size() {
+    long page_size = sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? (size_t) page_size : 4096;
+}
+
+// Return size rounded up to a whole number of pages
+static size_t cow_round_up(size_t size) {
+    size_t page_size = cow_page_size();
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+#if defined(MAP_ANONYMOUS) && defined(MAP_FIXED)
+
+// Return a new image of the whole pages of the first size bytes of bytes,
+// or NULL if the image cannot be made or would not hold a page
+cow_image *cow_image_create(const void *bytes, size_t size) {
+    cow_image *img;
+
+    size = size / cow_page_size() * cow_page_size();
+    if (size == 0)
+        return NULL;
+    img = (cow_image *) malloc(sizeof(cow_image));
+    if (img == NULL) {
+        bail_with_error("Cannot allocate space for a copy-on-write image");
+    }
+    img->size = size;
+    img->file = tmpfile();
+    if (img->file == NULL || fwrite(bytes, 1, size, img->file) != size
+        || fflush(img->file) != 0) {
+        if (img->file != NULL)
+            fclose(img->file);
+        free(img);
+        return NULL;
+    }
+    return img;
+}
+
+// Return a new, page aligned, block of size bytes that starts with
+// the bytes of img, shared copy-on-write, and is zero after them,
+// or NULL if it cannot be mapped
+void *cow_map(const cow_image *img, size_t size) {
+    size_t mapped_size = cow_round_up(size);
+    void *p = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED)
+        return NULL;
+    // replace the start of the block with a private mapping of the image,
+    // whose pages are copied by the kernel when first written
+    if (mmap(p, img->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fileno(img->file), 0) == MAP_FAILED) {
+        munmap(p, mapped_size);
+        return NULL;
+    }
+    return p;
+}
+
+// Free the block p, of the given size
+void cow_unmap(void *p, size_t size) {
+    munmap(p, cow_round_up(size));
+}
+
+// Free img
+void cow_image_destroy(cow_image *img) {
+    fclose(img->file);
+    free(img);
+}
+
+#else
+
+// Without anonymous and fixed mappings, there is never an image,
+// so the other functions (but cow_image_destroy) are never called.
+
+cow_image *cow_image_create(const void *bytes, size_t size) {
+    return NULL;
+}
+
+void *cow_map(const cow_image *img, size_t size) {
+    return NULL;
+}
+
+void cow_unmap(void *p, size_t size) {
+}
+
+void cow_image_destroy(cow_image *img) {
+}
+
+#endif
+
+// Return the number of bytes in img
+size_t cow_image_size(const cow_image *img) {
+    return img->size;
+}
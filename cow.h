@@ -0,0 +1,33 @@
+#ifndef _COW_H
+#define _COW_H
+
+#include <stddef.h>
+
+// A copy-on-write image: a read-only copy of some bytes (a VM's memory)
+// that any number of mappings can share, each getting a private copy
+// of a page only when it first writes to that page
+typedef struct cow_image cow_image;
+
+// Return a new image of the first size bytes of bytes, or NULL if this
+// host cannot share pages copy-on-write (the image cannot be made,
+// or it would not hold even one page), in which case nothing is shared.
+// Only the whole pages of bytes are in the image (see cow_image_size).
+extern cow_image *cow_image_create(const void *bytes, size_t size);
+
+// Return the number of bytes in img (a multiple of the page size)
+extern size_t cow_image_size(const cow_image *img);
+
+// Requires: size >= cow_image_size(img)
+// Return a new, page aligned, block of size bytes that starts with
+// the bytes of img, shared copy-on-write, and is zero after them,
+// or NULL if it cannot be mapped. It is freed with cow_unmap.
+extern void *cow_map(const cow_image *img, size_t size);
+
+// Requires: p was returned by cow_map with the given size
+// Free the block p
+extern void cow_unmap(void *p, size_t size);
+
+// Free img (the blocks mapped from it stay usable)
+extern void cow_image_destroy(cow_image *img);
+
+#endif
@@ -1,11 +1,28 @@
 /* $Id: disasm.c,v 1.9 2023/09/18 17:17:55 leavens Exp $ */
 #include <stdio.h>
+#include <stdlib.h>
 #include "disasm.h"
 #include "bof.h"
 #include "regname.h"
 #include "utilities.h"
 #include "instruction.h"
 
+// Read length words from bf (all at once) into a fresh array and return it;
+// the caller must free the array
+static word_type *disasmReadWords(BOFFILE bf, int length)
+{
+    if (length <= 0) {
+	return NULL;
+    }
+    word_type *words = (word_type *) malloc(length * sizeof(word_type));
+    if (words == NULL) {
+	bail_with_error("Cannot allocate space for %d words of %s!",
+			length, bf.filename);
+    }
+    bof_read_words(bf, words, length);
+    return words;
+}
+
 // Disassemble code from bf,
 // with output going to the file out
 void disasmProgram(FILE *out, BOFFILE bf)
@@ -31,9 +48,13 @@ void disasmTextSection(FILE *out, BOFFILE bf, BOFHeader bh)
 // with output going to the file out
 void disasmInstrs(FILE *out, BOFFILE bf, int length)
 {
+    word_type *words = disasmReadWords(bf, length);
+    wordAsInstr_t wi;
     for (int i = 0; i < length; i++) {
-	disasmInstr(out, instruction_read(bf), i*BYTES_PER_WORD);
+	wi.w = words[i];
+	disasmInstr(out, wi.bi, i*BYTES_PER_WORD);
     }
+    free(words);
 }
 
 // Disassemble the binary instruction bi, which would go at address i
@@ -56,10 +77,11 @@ void disasmDataSection(FILE *out, BOFFILE bf, BOFHeader bh)
 // Disassemble length static data words from bf, with output going to out
 void disasmStaticDecls(FILE *out, BOFFILE bf, int length)
 {
-    while (length > 0) {
-	disasmStaticDecl(out, bof_read_word(bf));
-	length--;
+    word_type *words = disasmReadWords(bf, length);
+    for (int i = 0; i < length; i++) {
+	disasmStaticDecl(out, words[i]);
     }
+    free(words);
 }
 
 // count of number of words generated, to get unique names
@@ -1,31 +1,70 @@
 /* $Id: file_location.c,v 1.3 2023/09/10 13:28:44 leavens Exp $ */
-#include <stdlib.h>
-#include <stddef.h>
+#include <string.h>
 #include "file_location.h"
 #include "utilities.h"
 
-// Requires: filename != NULL
-// Return a (pointer to a) fresh file_location with the given
-// information
-file_location *file_location_make(const char *filename,
-					 unsigned int line)
+#define FILE_LOCATION_MAX_LINE ((1u << FILE_LOCATION_LINE_BITS) - 1)
+
+// the file table: the names of the files that file_locations are in
+static const char *file_names[FILE_LOCATION_MAX_FILES];
+static unsigned int num_files = 0;
+
+// index of the name most recently looked up in file_names
+static unsigned int last_file = 0;
+
+// Return the index of filename in the file table,
+// adding it to the end of the table if it is not there yet
+static unsigned int file_location_file_index(const char *filename)
 {
-    file_location *ret = (file_location *) malloc(sizeof(file_location));
-    if (ret == NULL) {
-	bail_with_error("Could not allocate space for a file_location!");
+    if (last_file < num_files && file_names[last_file] == filename) {
+	return last_file;
+    }
+    for (unsigned int i = 0; i < num_files; i++) {
+	if (strcmp(file_names[i], filename) == 0) {
+	    last_file = i;
+	    return i;
+	}
     }
-    return ret;
+    if (num_files == FILE_LOCATION_MAX_FILES) {
+	bail_with_error("Too many source files (more than %d)!",
+			FILE_LOCATION_MAX_FILES);
+    }
+    file_names[num_files] = filename;
+    last_file = num_files;
+    return num_files++;
 }
 
-// Requires: fl != NULL
-// Return a (pointer to a) fresh copy of fl
-file_location *file_location_copy(file_location *fl)
+// Requires: filename != NULL and filename is not freed while
+//           file_locations in it are in use
+// Return a file_location with the given information,
+// adding filename to the file table if it is not there yet
+file_location file_location_make(const char *filename,
+					unsigned int line)
 {
-    file_location *ret = (file_location *) malloc(sizeof(file_location));
-    if (ret == NULL) {
-	bail_with_error("Could not allocate space for a file_location!");
+    if (line > FILE_LOCATION_MAX_LINE) {
+	line = FILE_LOCATION_MAX_LINE;
     }
-    ret->filename = fl->filename;
-    ret->line = fl->line;
-    return ret;
+    return (file_location_file_index(filename) << FILE_LOCATION_LINE_BITS)
+	| line;
+}
+
+// Return the name of the file of fl
+const char *file_location_filename(file_location fl)
+{
+    return file_names[fl >> FILE_LOCATION_LINE_BITS];
+}
+
+// Return the line number of fl
+unsigned int file_location_line(file_location fl)
+{
+    return fl & FILE_LOCATION_MAX_LINE;
+}
+
+// Empty the file table, so that it can be filled again
+// (e.g., for another assembly job);
+// file_locations made before this must not be used after it
+void file_location_reset()
+{
+    num_files = 0;
+    last_file = 0;
 }
@@ -2,20 +2,40 @@
 #ifndef _FILE_LOCATION_H
 #define _FILE_LOCATION_H
 
-// location in a source file (useful for error messages)
-typedef struct {
-    const char *filename;
-    unsigned int line; // of first token
-} file_location;
-
-// Requires: filename != NULL
-// Return a (pointer to a) fresh file_location with the given
-// information
-extern file_location *file_location_make(const char *filename,
-					 unsigned int line);
-
-// Requires: fl != NULL
-// Return a (pointer to a) fresh copy of fl
-extern file_location *file_location_copy(file_location *fl);
+// location in a source file (useful for error messages),
+// packed into 32 bits so ASTs can hold it inline:
+// the index of the file's name in the file table (in the high
+// FILE_LOCATION_FILE_BITS bits) and the line (of first token)
+// in the remaining bits.
+// It is only turned back into a name and line for messages.
+typedef unsigned int file_location;
+
+// number of bits of a file_location that hold the file table index
+#define FILE_LOCATION_FILE_BITS 8
+
+// number of bits of a file_location that hold the line number
+// (lines past the largest that fits are recorded as that largest line)
+#define FILE_LOCATION_LINE_BITS (32 - FILE_LOCATION_FILE_BITS)
+
+// the most file names the file table can hold
+#define FILE_LOCATION_MAX_FILES (1 << FILE_LOCATION_FILE_BITS)
+
+// Requires: filename != NULL and filename is not freed while
+//           file_locations in it are in use
+// Return a file_location with the given information,
+// adding filename to the file table if it is not there yet
+extern file_location file_location_make(const char *filename,
+					unsigned int line);
+
+// Return the name of the file of fl
+extern const char *file_location_filename(file_location fl);
+
+// Return the line number of fl
+extern unsigned int file_location_line(file_location fl);
+
+// Empty the file table, so that it can be filled again
+// (e.g., for another assembly job);
+// file_locations made before this must not be used after it
+extern void file_location_reset();
 
 #endif
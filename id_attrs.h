@@ -12,7 +12,7 @@ typedef enum {id_label, id_data} id_attr_kind;
 typedef struct {
     const char *name;
     id_attr_kind kind;
-    file_location *file_loc;
+    file_location file_loc;
     address_type addr;  // offset from start of text or data section
 } id_attrs;
 
@@ -13,7 +13,8 @@
 extern char *strdup(const char *s);
 
 // space to hold one instruction's assembly language form
-static char instr_buf[INSTR_BUF_SIZE];
+// (one per thread, so VMs in different threads can trace at once)
+static _Thread_local char instr_buf[INSTR_BUF_SIZE];
 
 // Return the type of the instruction given
 instr_type instruction_type(bin_instr_t i) {
@@ -71,29 +72,61 @@ void instr_write_bin_instr(BOFFILE bf, bin_instr_t i)
     }
 }
 
-// Requires: bof is open for writing in binary
-// Write the register instruction ri to bf in binary,
-// but exit with an error if there is a problem.
-void instruction_write_regInstr(BOFFILE bf, reg_instr_t ri)
+// Return the register instruction ri in binary form
+bin_instr_t instruction_make_regInstr(reg_instr_t ri)
 {
     bin_instr_t bi;
     bi.reg = ri;
     bi.reg.op = REG_O;
     assert(instruction_type(bi) == reg_instr_type);
-    instr_write_bin_instr(bf, bi);
+    return bi;
 }
 
-// Requires: bof is open for writing in binary
-// Write the system instruction si to bf in binary,
-// but exit with an error if there is a problem.
-void instruction_write_syscallInstr(BOFFILE bf, syscall_instr_t si)
+// Return the system instruction si in binary form
+bin_instr_t instruction_make_syscallInstr(syscall_instr_t si)
 {
     bin_instr_t bi;
     bi.syscall = si;
     bi.syscall.op = REG_O;
     bi.syscall.func = SYSCALL_F;
     assert(instruction_type(bi) == syscall_instr_type);
-    instr_write_bin_instr(bf, bi);
+    return bi;
+}
+
+// Return the immediate instruction ii with opcode op in binary form
+bin_instr_t instruction_make_immedInstr(unsigned short op, immed_instr_t ii)
+{
+    bin_instr_t bi;
+    bi.immed = ii;
+    bi.immed.op = op;
+    assert(instruction_type(bi) == immed_instr_type);
+    return bi;
+}
+
+// Return the jump instruction ji with opcode op in binary form
+bin_instr_t instruction_make_jumpInstr(unsigned short op, jump_instr_t ji)
+{
+    bin_instr_t bi;
+    bi.jump = ji;
+    bi.jump.op = op;
+    assert(instruction_type(bi) == jump_instr_type);
+    return bi;
+}
+
+// Requires: bof is open for writing in binary
+// Write the register instruction ri to bf in binary,
+// but exit with an error if there is a problem.
+void instruction_write_regInstr(BOFFILE bf, reg_instr_t ri)
+{
+    instr_write_bin_instr(bf, instruction_make_regInstr(ri));
+}
+
+// Requires: bof is open for writing in binary
+// Write the system instruction si to bf in binary,
+// but exit with an error if there is a problem.
+void instruction_write_syscallInstr(BOFFILE bf, syscall_instr_t si)
+{
+    instr_write_bin_instr(bf, instruction_make_syscallInstr(si));
 }
 
 
@@ -103,11 +136,7 @@ void instruction_write_syscallInstr(BOFFILE bf, syscall_instr_t si)
 void instruction_write_immedInstr(BOFFILE bf, unsigned short op,
 				  immed_instr_t ii)
 {
-    bin_instr_t bi;
-    bi.immed = ii;
-    bi.immed.op = op;
-    assert(instruction_type(bi) == immed_instr_type);
-    instr_write_bin_instr(bf, bi);
+    instr_write_bin_instr(bf, instruction_make_immedInstr(op, ii));
 }
 
 // Requires: bof is open for writing in binary
@@ -116,11 +145,7 @@ void instruction_write_immedInstr(BOFFILE bf, unsigned short op,
 void instruction_write_jumpInstr(BOFFILE bf, unsigned short op,
 				  jump_instr_t ji)
 {
-    bin_instr_t bi;
-    bi.jump = ji;
-    bi.jump.op = op;
-    assert(instruction_type(bi) == jump_instr_type);
-    instr_write_bin_instr(bf, bi);
+    instr_write_bin_instr(bf, instruction_make_jumpInstr(op, ji));
 }
 
 // Requires: instr is a SYSCALL instruction
@@ -131,9 +156,19 @@ syscall_type instruction_syscall_number(bin_instr_t instr) {
     return instr.syscall.code;
 }
 
-// Return the mnemonic for the given system call code
-const char *instruction_syscall_mnemonic(unsigned int code)
+// Mnemonics of the system calls given them by instruction_add_syscall_mnemonic
+static struct {
+    unsigned int code;
+    const char *mnemonic;
+} added_syscalls[MAX_ADDED_SYSCALLS];
+static int num_added_syscalls = 0;
+
+// Return the mnemonic for the given system call code,
+// or NULL if it does not have one
+static const char *syscall_mnemonic_or_null(unsigned int code)
 {
+    int i;
+
     switch (code) {
     case exit_sc:
 	return "EXIT";
@@ -153,12 +188,58 @@ const char *instruction_syscall_mnemonic(unsigned int code)
     case stop_tracing_sc:
 	return "NOTR";
 	break;
+    case read_bytes_sc:
+	return "READ";
+	break;
+    case write_bytes_sc:
+	return "WRITE";
+	break;
+    case copy_bytes_sc:
+	return "MCPY";
+	break;
+    case set_bytes_sc:
+	return "MSET";
+	break;
     default:
+	for (i = 0; i < num_added_syscalls; i++) {
+	    if (added_syscalls[i].code == code) {
+		return added_syscalls[i].mnemonic;
+	    }
+	}
+	return NULL;
+	break;
+    }
+}
+
+// Return the mnemonic for the given system call code
+const char *instruction_syscall_mnemonic(unsigned int code)
+{
+    const char *ret = syscall_mnemonic_or_null(code);
+    if (ret == NULL) {
 	bail_with_error("Unknown code (%d) in instruction_syscall_mnemonic",
 			code);
-	return "NEVERHAPPENS";
-	break;
     }
+    return ret;
+}
+
+// Does the given system call code have a mnemonic?
+bool instruction_syscall_known(unsigned int code)
+{
+    return syscall_mnemonic_or_null(code) != NULL;
+}
+
+// Requires: code does not have a mnemonic yet
+// Make mnemonic the mnemonic of the system call code,
+// exiting with an error if there are already MAX_ADDED_SYSCALLS
+void instruction_add_syscall_mnemonic(unsigned int code, const char *mnemonic)
+{
+    if (num_added_syscalls == MAX_ADDED_SYSCALLS) {
+	bail_with_error("Cannot add a mnemonic for system call %u,"
+			" there are already %d", code, MAX_ADDED_SYSCALLS);
+    }
+    added_syscalls[num_added_syscalls].code = code;
+    added_syscalls[num_added_syscalls].mnemonic = mnemonic;
+    num_added_syscalls++;
 }
 
 // Given a binary instruction, bi, for a register format instruction
@@ -278,7 +359,7 @@ const char *instruction_mnemonic(bin_instr_t i) {
     return NULL;
 }
 
-static char offset_comment_buf[512];
+static _Thread_local char offset_comment_buf[512];
 
 // return a comment string of the form
 // "# offset is +/-d bytes"
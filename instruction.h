@@ -21,11 +21,18 @@ typedef enum {ADD_F = 33, SUB_F = 35, MUL_F = 25, DIV_F = 27,
 typedef enum {reg_instr_type, syscall_instr_type, immed_instr_type,
     jump_instr_type, error_instr_type} instr_type;
 
-// system calls
+// system calls (the VM's bulk ones, from read_bytes_sc on, take their
+// arguments in $a0, $a1, and $a2, see machine.c)
 typedef enum {exit_sc = 10, print_str_sc = 4, print_char_sc = 11,
-	      read_char_sc = 12, start_tracing_sc = 256, stop_tracing_sc = 257
+	      read_char_sc = 12, start_tracing_sc = 256, stop_tracing_sc = 257,
+	      read_bytes_sc = 14, write_bytes_sc = 15,
+	      copy_bytes_sc = 16, set_bytes_sc = 17
 } syscall_type;
 
+// The most system call codes that can be given mnemonics
+// with instruction_add_syscall_mnemonic
+#define MAX_ADDED_SYSCALLS 64
+
 // register/computational type instructions, except system calls
 typedef struct {
     unsigned short op : 6;  // opcode, 6 bits
@@ -79,6 +86,20 @@ extern instr_type instruction_type(bin_instr_t i);
 // but exit with an error if there is a problem.
 extern bin_instr_t instruction_read(BOFFILE bf);
 
+// Return the register instruction ri in binary form
+extern bin_instr_t instruction_make_regInstr(reg_instr_t ri);
+
+// Return the system instruction si in binary form
+extern bin_instr_t instruction_make_syscallInstr(syscall_instr_t si);
+
+// Return the immediate instruction ii with opcode op in binary form
+extern bin_instr_t instruction_make_immedInstr(unsigned short op,
+					       immed_instr_t ii);
+
+// Return the jump instruction ji with opcode op in binary form
+extern bin_instr_t instruction_make_jumpInstr(unsigned short op,
+					      jump_instr_t ji);
+
 // Requires: bof is open for writing in binary
 // Write the register instruction ri to bf in binary,
 // but exit with an error if there is a problem.
@@ -124,6 +145,16 @@ extern syscall_type instruction_syscall_number(bin_instr_t instr);
 // Return the mnemonic for the given system call code
 extern const char *instruction_syscall_mnemonic(unsigned int code);
 
+// Does the given system call code have a mnemonic?
+extern bool instruction_syscall_known(unsigned int code);
+
+// Requires: code does not have a mnemonic yet
+// Make mnemonic the mnemonic of the system call code (for system calls
+// added to the VM), which is used from then on when printing instructions.
+// The mnemonic is not copied. Exit with an error if there are already
+// MAX_ADDED_SYSCALLS added mnemonics.
+extern void instruction_add_syscall_mnemonic(unsigned int code, const char *mnemonic);
+
 // Given a binary instruction, bi, for a register format instruction
 // return a string giving the assembly language mnemonic for it
 extern const char *instruction_func2name(bin_instr_t bi);
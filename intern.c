@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "intern.h"
+#include "utilities.h"
+
+// The interned strings are kept in an open-addressing hash table
+// (with linear probing) that doubles whenever it gets half full.
+
+// The number of slots the table starts with (a power of 2)
+#define INTERN_INITIAL_SLOTS 256
+
+// a slot of the table: an interned string (NULL if the slot is empty)
+// and its hash
+typedef struct {
+    const char *str;
+    unsigned int hash;
+} intern_slot;
+
+// the interned strings are copied into an arena of their own (not
+// parse_arena), so they outlive the parse memory that single-pass
+// assembly frees after each statement, as the symbol table needs
+static arena_t intern_arena = { NULL, NULL };
+
+static intern_slot *slots = NULL;
+static unsigned int num_slots = 0;   // a power of 2 (or 0 before the first intern)
+static unsigned int num_strings = 0;
+
+// Return the hash of the string s (FNV-1a)
+unsigned int intern_hash(const char *s)
+{
+    unsigned int h = 2166136261u;
+    while (*s != '\0') {
+	h ^= (unsigned char) *s++;
+	h *= 16777619u;
+    }
+    return h;
+}
+
+// Put str, whose hash is hash, in the first empty slot for it
+static void intern_place(const char *str, unsigned int hash)
+{
+    unsigned int i = hash & (num_slots - 1);
+    while (slots[i].str != NULL) {
+	i = (i + 1) & (num_slots - 1);
+    }
+    slots[i].str = str;
+    slots[i].hash = hash;
+}
+
+// Make the table twice as big (or give it its first slots)
+static void intern_grow()
+{
+    intern_slot *old = slots;
+    unsigned int old_num = num_slots;
+
+    num_slots = old_num == 0 ? INTERN_INITIAL_SLOTS : 2 * old_num;
+    slots = (intern_slot *) calloc(num_slots, sizeof(intern_slot));
+    if (slots == NULL) {
+	bail_with_error("Cannot allocate space for %u interned strings!",
+			num_slots);
+    }
+    for (unsigned int i = 0; i < old_num; i++) {
+	if (old[i].str != NULL) {
+	    intern_place(old[i].str, old[i].hash);
+	}
+    }
+    free(old);
+}
+
+// Requires: s != NULL
+// Return the interned copy of s, copying s into the arena
+// of interned strings the first time it is seen
+const char *intern(const char *s)
+{
+    unsigned int hash = intern_hash(s);
+
+    if (2 * (num_strings + 1) > num_slots) {
+	intern_grow();
+    }
+    unsigned int i = hash & (num_slots - 1);
+    while (slots[i].str != NULL) {
+	if (slots[i].hash == hash && strcmp(slots[i].str, s) == 0) {
+	    return slots[i].str;
+	}
+	i = (i + 1) & (num_slots - 1);
+    }
+
+    const char *copy = arena_strdup(&intern_arena, s);
+    slots[i].str = copy;
+    slots[i].hash = hash;
+    num_strings++;
+    return copy;
+}
+
+// Forget (and free) all the interned strings
+void intern_reset()
+{
+    arena_release(&intern_arena);
+    free(slots);
+    slots = NULL;
+    num_slots = 0;
+    num_strings = 0;
+}
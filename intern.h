@@ -0,0 +1,23 @@
+#ifndef _INTERN_H
+#define _INTERN_H
+
+// Interned strings: the assembler keeps one copy of each distinct
+// identifier, so equal names are the same pointer and can be compared
+// (and hashed) without looking at their chars again.
+
+// Return the hash of the string s (the same one the interned strings
+// and the symbol table use)
+extern unsigned int intern_hash(const char *s);
+
+// Requires: s != NULL
+// Return the interned copy of s: a string equal to s that is
+// the same pointer for all equal strings. The copy lasts until
+// intern_reset is called (even if parse_arena is released first).
+// Exit with an error if there is not enough memory for it.
+extern const char *intern(const char *s);
+
+// Forget (and free) all the interned strings, so the next call of intern
+// copies its argument again. Call this when parse_arena is released.
+extern void intern_reset();
+
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bof.h"
+#include "iolog.h"
+
+// Open filename for writing an I/O log, write the log's header,
+// and return the open file. Exit with an error if this fails.
+BOFFILE iolog_write_open(const char *filename) {
+    char magic[MAGIC_BUFFER_SIZE] = IOLOG_MAGIC;
+    BOFFILE bf = bof_write_open(filename);
+
+    bof_write_bytes(bf, MAGIC_BUFFER_SIZE, magic);
+    return bf;
+}
+
+// Write the start of an event: its tag, instruction count, and result
+static void iolog_write_event(BOFFILE bf, int t, unsigned long long count, word_type result) {
+    unsigned char tag = t;
+
+    bof_write_bytes(bf, sizeof(tag), &tag);
+    bof_write_word(bf, (word_type) (count & 0xFFFFFFFF));
+    bof_write_word(bf, (word_type) (count >> 32));
+    bof_write_word(bf, result);
+}
+
+// Record that the read system call at instruction count returned result
+void iolog_write_read(BOFFILE bf, unsigned long long count, word_type result) {
+    iolog_write_event(bf, IOLOG_READ, count, result);
+}
+
+// Write an event with tag that carries the length bytes at bytes
+static void iolog_write_bytes_event(BOFFILE bf, int tag, unsigned long long count,
+                                    word_type result, const char *bytes, size_t length) {
+    iolog_write_event(bf, tag, count, result);
+    bof_write_word(bf, (word_type) length);
+    if (length > 0)
+        bof_write_bytes(bf, length, bytes);
+}
+
+// Record that the write system call at instruction count wrote the length
+// bytes at bytes and returned result
+void iolog_write_output(BOFFILE bf, unsigned long long count, word_type result,
+                        const char *bytes, size_t length) {
+    iolog_write_bytes_event(bf, IOLOG_WRITE, count, result, bytes, length);
+}
+
+// Record that the bulk read system call at instruction count read the length
+// bytes at bytes and returned result
+void iolog_write_input(BOFFILE bf, unsigned long long count, word_type result,
+                       const char *bytes, size_t length) {
+    iolog_write_bytes_event(bf, IOLOG_READ_BYTES, count, result, bytes, length);
+}
+
+// Open filename for reading an I/O log, read the log's header, and set *bf
+// to the open file, returning true.
+// Return false if the file cannot be read or is not an I/O log,
+// putting a message that says so in error (of size error_size).
+bool iolog_read_open(const char *filename, BOFFILE *bf,
+                     char *error, size_t error_size) {
+    char magic[MAGIC_BUFFER_SIZE];
+
+    bf->filename = filename;
+    bf->fileptr = fopen(filename, "rb");
+    if (bf->fileptr == NULL) {
+        snprintf(error, error_size, "Error opening file for reading: %s", filename);
+        return false;
+    }
+    if (bof_read_bytes(*bf, MAGIC_BUFFER_SIZE, magic) != 1
+        || strncmp(magic, IOLOG_MAGIC, MAGIC_BUFFER_SIZE) != 0) {
+        snprintf(error, error_size, "File %s is not an I/O log, bad magic number!", filename);
+        fclose(bf->fileptr);
+        return false;
+    }
+    return true;
+}
+
+// Read the next event of bf into *event and return 1,
+// or return 0 at the end of the log.
+// Return -1 if the event is bad or the log ends in the middle of it,
+// putting a message that says so in error (of size error_size).
+int iolog_read_event(BOFFILE bf, iolog_event *event,
+                     char *error, size_t error_size) {
+    unsigned char tag;
+    word_type words[4];
+    size_t num_words;
+    char *bytes;
+
+    if (bof_read_bytes(bf, sizeof(tag), &tag) != 1) {
+        return 0;
+    }
+    if (tag != IOLOG_READ && tag != IOLOG_WRITE && tag != IOLOG_READ_BYTES) {
+        snprintf(error, error_size, "Bad event tag (%d) in I/O log %s", tag, bf.filename);
+        return -1;
+    }
+    // the count (two words) and result, then the length if bytes follow
+    num_words = tag == IOLOG_READ ? 3 : 4;
+    if (fread(words, BYTES_PER_WORD, num_words, bf.fileptr) != num_words) {
+        snprintf(error, error_size, "I/O log %s ends in the middle of an event", bf.filename);
+        return -1;
+    }
+    event->tag = tag;
+    event->count = (unsigned) words[0] | ((unsigned long long) (unsigned) words[1] << 32);
+    event->result = words[2];
+    event->length = 0;
+    if (tag != IOLOG_READ) {
+        event->length = (unsigned) words[3];
+        if (event->length > event->capacity) {
+            bytes = realloc(event->bytes, event->length);
+            if (bytes == NULL) {
+                snprintf(error, error_size,
+                         "Cannot allocate space for an event of I/O log %s", bf.filename);
+                return -1;
+            }
+            event->bytes = bytes;
+            event->capacity = event->length;
+        }
+        if (event->length > 0 && bof_read_bytes(bf, event->length, event->bytes) != 1) {
+            snprintf(error, error_size, "I/O log %s ends in the middle of an event", bf.filename);
+            return -1;
+        }
+    }
+    return 1;
+}
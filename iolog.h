@@ -0,0 +1,68 @@
+#ifndef _IOLOG_H
+#define _IOLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "bof.h"
+#include "machine_types.h"
+
+// An I/O log records what a program read and wrote through its system calls,
+// each with the instruction count when the call ran, so that the run can be
+// replayed later without its input (see the VM's -record and -replay options).
+// It starts with the magic "IOL". Each event follows, as a one byte tag,
+// the instruction count (two words, low word first), and the result the
+// system call returned (a word). An IOLOG_WRITE event then has the number
+// of bytes written (a word) and the bytes, and an IOLOG_READ_BYTES event
+// the same for the bytes read.
+// All numbers are stored in the machine's byte order, as in BOF files.
+
+#define IOLOG_MAGIC "IOL"
+#define IOLOG_READ 1     // RCH, whose result is the character read (or EOF)
+#define IOLOG_WRITE 2    // PCH, PSTR, or WRITE
+#define IOLOG_READ_BYTES 3  // READ, whose result is the number of bytes read
+
+// One event of an I/O log, as read by iolog_read_event
+typedef struct {
+    int tag;                      // IOLOG_READ, IOLOG_WRITE, or IOLOG_READ_BYTES
+    unsigned long long count;     // the instruction count at the system call
+    word_type result;             // what the system call returned
+    size_t length;                // bytes written or read (not for IOLOG_READ)
+    char *bytes;                  // the bytes written or read (not for IOLOG_READ)
+    size_t capacity;              // the size of bytes (it is reused and grown)
+} iolog_event;
+
+// Open filename for writing an I/O log, write the log's header, and return
+// the open file (to be closed with bof_close). Exit with an error if this fails.
+extern BOFFILE iolog_write_open(const char *filename);
+
+// Record that the read system call at instruction count returned result
+extern void iolog_write_read(BOFFILE bf, unsigned long long count, word_type result);
+
+// Record that the write system call at instruction count wrote the length
+// bytes at bytes and returned result
+extern void iolog_write_output(BOFFILE bf, unsigned long long count, word_type result,
+                               const char *bytes, size_t length);
+
+// Record that the bulk read system call at instruction count read the length
+// bytes at bytes and returned result
+extern void iolog_write_input(BOFFILE bf, unsigned long long count, word_type result,
+                              const char *bytes, size_t length);
+
+// Open filename for reading an I/O log, read the log's header, and set *bf
+// to the open file (to be closed with bof_close), returning true.
+// Return false if the file cannot be read or is not an I/O log,
+// putting a message that says so in error (of size error_size).
+// (This does not exit, so a program can go on after a bad log.)
+extern bool iolog_read_open(const char *filename, BOFFILE *bf,
+                            char *error, size_t error_size);
+
+// Requires: bf was opened by iolog_read_open, and event->bytes is NULL
+//           or was allocated by an earlier call with the same event
+// Read the next event of bf into *event and return 1,
+// or return 0 at the end of the log.
+// Return -1 if the event is bad or the log ends in the middle of it,
+// putting a message that says so in error (of size error_size).
+extern int iolog_read_event(BOFFILE bf, iolog_event *event,
+                            char *error, size_t error_size);
+
+#endif
@@ -0,0 +1,625 @@
+// for MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "machine.h"
+#include "utilities.h"
+#include "jit.h"
+
+// Size of the buffer that holds the compiled code of one VM
+// (which is writable while a block is compiled, and executable otherwise)
+#define JIT_CODE_SIZE (1024 * 1024)
+
+// How many times an address is reached before the block starting there
+// is compiled (must be less than 255, the most a heat count holds)
+#define JIT_THRESHOLD 50
+
+// The most instructions in one compiled block
+#define JIT_MAX_BLOCK 256
+
+// More than the most bytes of code compiled for one instruction (SW, with
+// its address check's call to vm_memory_fault, its calls to
+// predecode_refresh and error_check, twice, and an epilogue),
+// so enough room to compile any block
+#define JIT_MAX_INSTR_CODE 384
+#define JIT_MAX_BLOCK_CODE (JIT_MAX_BLOCK * JIT_MAX_INSTR_CODE)
+
+struct jit_cache {
+    unsigned char *code;     // the code buffer (JIT_CODE_SIZE bytes)
+    size_t used;             // bytes of code used
+    int length;              // number of pre-decoded words in the text section
+    jit_block *blocks;       // the compiled block starting at each word, or NULL
+    unsigned char *heat;     // times each word was looked up, up to JIT_THRESHOLD
+    unsigned char *covered;  // is the word in any compiled block?
+};
+
+#if defined(__x86_64__) && defined(MAP_ANONYMOUS)
+
+// The generated code keeps the vm_state * in rbx (saved in the block's
+// prologue) and uses eax, ecx, and edx as scratch registers; the VM's
+// registers stay in the vm_state, which is where error_check and the
+// interpreter look for them.
+
+// x86-64 register numbers
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSI = 6, RDI = 7 };
+
+// x86-64 opcodes (the ones with /ext take an opcode extension
+// in the reg field of their ModRM byte)
+#define X86_ADD_LOAD 0x03     // add r32, r/m32
+#define X86_OR_LOAD 0x0B      // or r32, r/m32
+#define X86_AND_LOAD 0x23     // and r32, r/m32
+#define X86_SUB_LOAD 0x2B     // sub r32, r/m32
+#define X86_XOR_LOAD 0x33     // xor r32, r/m32
+#define X86_CMP_LOAD 0x3B     // cmp r32, r/m32
+#define X86_ALU_IMM 0x81      // add (/0), or (/1), and (/4), xor (/6) r/m32, imm32
+#define X86_CMP_IMM8 0x83     // cmp (/7) r/m32, imm8
+#define X86_MOV_STORE 0x89    // mov r/m32, r32
+#define X86_MOV_LOAD 0x8B     // mov r32, r/m32
+#define X86_SHIFT_IMM 0xC1    // shl (/4), sar (/7) r/m32, imm8
+#define X86_MOV_IMM 0xC7      // mov (/0) r/m32, imm32
+#define X86_GROUP3 0xF7       // not (/2), imul (/5), idiv (/7) r/m32
+
+// offsets of the vm_state fields the generated code uses
+#define GPR_OFFSET(r) ((int) (offsetof(vm_state, GPR) + (r) * sizeof(word_type)))
+#define HI_OFFSET ((int) offsetof(vm_state, HI))
+#define LO_OFFSET ((int) offsetof(vm_state, LO))
+#define PC_OFFSET ((int) offsetof(vm_state, PC))
+#define MEMORY_OFFSET ((int) offsetof(vm_state, memory))
+#define COUNT_OFFSET ((int) offsetof(vm_state, instruction_count))
+#define LOADS_OFFSET ((int) offsetof(vm_state, loads))
+#define STORES_OFFSET ((int) offsetof(vm_state, stores))
+#define TAKEN_OFFSET ((int) offsetof(vm_state, taken_branches))
+
+// Size of the code emit_add_counter writes
+#define ADD_COUNTER_SIZE 11
+
+// Where code is being written
+typedef struct {
+    unsigned char *p;
+} jit_emitter;
+
+// Write the byte b
+static void emit_byte(jit_emitter *e, int b) {
+    *e->p++ = (unsigned char) b;
+}
+
+// Write the 32-bit value v
+static void emit_int(jit_emitter *e, int v) {
+    memcpy(e->p, &v, sizeof(v));
+    e->p += sizeof(v);
+}
+
+// Write the 64-bit value v
+static void emit_quad(jit_emitter *e, uint64_t v) {
+    memcpy(e->p, &v, sizeof(v));
+    e->p += sizeof(v);
+}
+
+// Write opcode with the operands reg (or opcode extension) and [rbx + disp]
+static void emit_field_op(jit_emitter *e, int opcode, int reg, int disp) {
+    emit_byte(e, opcode);
+    emit_byte(e, 0x80 | reg << 3 | RBX);
+    emit_int(e, disp);
+}
+
+// Write opcode with the operands reg (or opcode extension) and the register rm
+static void emit_reg_op(jit_emitter *e, int opcode, int reg, int rm) {
+    emit_byte(e, opcode);
+    emit_byte(e, 0xC0 | reg << 3 | rm);
+}
+
+// mov reg, [rbx + disp]
+static void emit_load(jit_emitter *e, int reg, int disp) {
+    emit_field_op(e, X86_MOV_LOAD, reg, disp);
+}
+
+// mov [rbx + disp], reg
+static void emit_store(jit_emitter *e, int reg, int disp) {
+    emit_field_op(e, X86_MOV_STORE, reg, disp);
+}
+
+// mov dword [rbx + disp], imm
+static void emit_store_imm(jit_emitter *e, int disp, int imm) {
+    emit_field_op(e, X86_MOV_IMM, 0, disp);
+    emit_int(e, imm);
+}
+
+// add (or, and, xor) eax, imm
+static void emit_alu_imm(jit_emitter *e, int ext, int imm) {
+    emit_reg_op(e, X86_ALU_IMM, ext, RAX);
+    emit_int(e, imm);
+}
+
+// eax = GPR[rs] + offset, a load or store's byte address
+static void emit_address(jit_emitter *e, int rs, int offset) {
+    emit_load(e, RAX, GPR_OFFSET(rs));
+    emit_alu_imm(e, 0, offset);
+}
+
+// eax = eax / BYTES_PER_WORD, rounding toward zero as C does
+static void emit_word_index(jit_emitter *e) {
+    emit_byte(e, 0x8D);   // lea ecx, [rax + 3]
+    emit_byte(e, 0x48);
+    emit_byte(e, BYTES_PER_WORD - 1);
+    emit_reg_op(e, 0x85, RAX, RAX);  // test eax, eax
+    emit_byte(e, 0x0F);   // cmovs eax, ecx
+    emit_reg_op(e, 0x48, RAX, RCX);
+    emit_reg_op(e, X86_SHIFT_IMM, 7, RAX);  // sar eax, 2
+    emit_byte(e, 2);
+}
+
+// rax = eax, sign extended
+static void emit_sign_extend(jit_emitter *e) {
+    emit_byte(e, 0x48);
+    emit_reg_op(e, 0x63, RAX, RAX);
+}
+
+// Write opcode with the operands reg and [rbx + rax * scale + MEMORY_OFFSET]
+// (scale_bits is 0 for bytes, 2 for words)
+static void emit_memory_op(jit_emitter *e, int opcode, int reg, int scale_bits) {
+    emit_byte(e, opcode);
+    emit_byte(e, 0x80 | reg << 3 | 4);  // a SIB byte follows
+    emit_byte(e, scale_bits << 6 | RAX << 3 | RBX);
+    emit_int(e, MEMORY_OFFSET);
+}
+
+// Add n to the VM's counter (an unsigned long long) at [rbx + disp]
+static void emit_add_counter(jit_emitter *e, int disp, int n) {
+    emit_byte(e, 0x48);   // add qword [rbx + disp], n
+    emit_field_op(e, X86_ALU_IMM, 0, disp);
+    emit_int(e, n);
+}
+
+// Add n to the VM's instruction count
+static void emit_count(jit_emitter *e, int n) {
+    if (n == 0)
+        return;
+    emit_add_counter(e, COUNT_OFFSET, n);
+}
+
+// Call fn(vm) (or fn(vm, esi), if esi has been set)
+static void emit_call(jit_emitter *e, uintptr_t fn) {
+    emit_byte(e, 0x48);   // mov rdi, rbx
+    emit_reg_op(e, X86_MOV_STORE, RBX, RDI);
+    emit_byte(e, 0x48);   // mov rax, fn
+    emit_byte(e, 0xB8 + RAX);
+    emit_quad(e, fn);
+    emit_reg_op(e, 0xFF, 2, RAX);  // call rax
+}
+
+// Start a block: save rbx and keep the vm_state * there
+static void emit_prologue(jit_emitter *e) {
+    emit_byte(e, 0x50 + RBX);   // push rbx
+    emit_byte(e, 0x48);         // mov rbx, rdi
+    emit_reg_op(e, X86_MOV_STORE, RDI, RBX);
+}
+
+// Return from a block
+static void emit_epilogue(jit_emitter *e) {
+    emit_byte(e, 0x58 + RBX);   // pop rbx
+    emit_byte(e, 0xC3);         // ret
+}
+
+// Set PC to next_pc and check the invariants, as the interpreter does
+// after an instruction that can break one, counting the pending instructions
+static void emit_error_check(jit_emitter *e, int next_pc, int pending) {
+    emit_store_imm(e, PC_OFFSET, next_pc);
+    emit_count(e, pending);
+    emit_call(e, (uintptr_t) error_check);
+}
+
+// Write the code of the register-type instruction pi whose result
+// is computed from GPR[rs] and GPR[rt] by the x86 instruction opcode
+static void emit_reg_alu(jit_emitter *e, const predecoded_instr_t *pi, int opcode) {
+    emit_load(e, RAX, GPR_OFFSET(pi->rs));
+    emit_field_op(e, opcode, RAX, GPR_OFFSET(pi->rt));
+    emit_store(e, RAX, GPR_OFFSET(pi->rd));
+}
+
+// Write the code of the immediate instruction pi whose result is computed
+// from GPR[rs] and arg by the x86 instruction X86_ALU_IMM /ext
+static void emit_immed_alu(jit_emitter *e, const predecoded_instr_t *pi, int ext) {
+    emit_load(e, RAX, GPR_OFFSET(pi->rs));
+    emit_alu_imm(e, ext, pi->arg);
+    emit_store(e, RAX, GPR_OFFSET(pi->rt));
+}
+
+// Write the code of a conditional branch, given the (short) x86 jump
+// that skips setting PC to the target (and counting the taken branch)
+// when the branch is not taken (after comparing as the branch does)
+static void emit_branch(jit_emitter *e, const predecoded_instr_t *pi,
+                        int next_pc, int skip_opcode) {
+    emit_store_imm(e, PC_OFFSET, next_pc);
+    emit_byte(e, skip_opcode);
+    emit_byte(e, 10 + ADD_COUNTER_SIZE);   // the size of the store and add below
+    emit_store_imm(e, PC_OFFSET, pi->arg);
+    emit_add_counter(e, TAKEN_OFFSET, 1);
+}
+
+// Set the PC and count as they would be after the instruction that
+// ends at next_pc, and call fn (a fault, which does not return),
+// whose arguments after the vm_state * are in esi and edx
+static void emit_fault(jit_emitter *e, uintptr_t fn, int next_pc, int pending) {
+    emit_store_imm(e, PC_OFFSET, next_pc);
+    emit_count(e, pending);
+    emit_call(e, fn);
+}
+
+// Make the rel32 of a jump at jump (which is 4 bytes long) go to
+// where the code is being written now
+static void emit_patch_jump(jit_emitter *e, unsigned char *jump) {
+    int distance = (int) (e->p - (jump + sizeof(int)));
+    memcpy(jump, &distance, sizeof(distance));
+}
+
+// Write the check that the size bytes at the address in eax are all in
+// memory, as check_address does, calling vm_memory_fault if not
+static void emit_address_check(jit_emitter *e, int size, int next_pc, int pending) {
+    unsigned char *skip;
+
+    emit_byte(e, 0x3D);   // cmp eax, MEMORY_SIZE_IN_BYTES - size
+    emit_int(e, MEMORY_SIZE_IN_BYTES - size);
+    emit_byte(e, 0x0F);   // jbe skip (unsigned, so negative addresses fail too)
+    emit_byte(e, 0x86);
+    skip = e->p;
+    emit_int(e, 0);
+    emit_reg_op(e, X86_MOV_STORE, RAX, RSI);   // mov esi, eax
+    emit_byte(e, 0xB8 + RDX);                  // mov edx, size
+    emit_int(e, size);
+    emit_fault(e, (uintptr_t) vm_memory_fault, next_pc, pending);
+    emit_patch_jump(e, skip);
+}
+
+// Write the check that eax can be divided by ecx, as check_division does,
+// calling vm_division_fault if not
+static void emit_division_check(jit_emitter *e, int next_pc, int pending) {
+    unsigned char *ok_divisor, *ok_dividend;
+
+    emit_reg_op(e, 0x85, RCX, RCX);   // test ecx, ecx
+    emit_byte(e, 0x74);               // jz fault (past the 20 bytes below)
+    emit_byte(e, 20);
+    emit_reg_op(e, 0x83, 7, RCX);     // cmp ecx, -1
+    emit_byte(e, 0xFF);
+    emit_byte(e, 0x0F);               // jne ok
+    emit_byte(e, 0x85);
+    ok_divisor = e->p;
+    emit_int(e, 0);
+    emit_byte(e, 0x3D);               // cmp eax, INT_MIN
+    emit_int(e, INT_MIN);
+    emit_byte(e, 0x0F);               // jne ok
+    emit_byte(e, 0x85);
+    ok_dividend = e->p;
+    emit_int(e, 0);
+    // fault:
+    emit_reg_op(e, X86_MOV_STORE, RAX, RSI);   // mov esi, eax
+    emit_reg_op(e, X86_MOV_STORE, RCX, RDX);   // mov edx, ecx
+    emit_fault(e, (uintptr_t) vm_division_fault, next_pc, pending);
+    // ok:
+    emit_patch_jump(e, ok_divisor);
+    emit_patch_jump(e, ok_dividend);
+}
+
+// Write the end of a store (whose word index is in eax): if it wrote to
+// the pre-decoded text, call predecode_refresh and leave the block,
+// which may have changed. (The PC, count, and invariant check are then
+// as they would be after the store.)
+static void emit_store_refresh(jit_emitter *e, const predecoded_instr_t *pi,
+                               int length, int next_pc, int pending) {
+    unsigned char *skip;
+
+    emit_byte(e, 0x3D);   // cmp eax, length
+    emit_int(e, length);
+    emit_byte(e, 0x0F);   // jae skip (the index is unsigned, so negative ones skip too)
+    emit_byte(e, 0x83);
+    skip = e->p;
+    emit_int(e, 0);
+    emit_reg_op(e, X86_MOV_STORE, RAX, RSI);   // mov esi, eax
+    emit_store_imm(e, PC_OFFSET, next_pc);
+    emit_count(e, pending);
+    emit_call(e, (uintptr_t) predecode_refresh);
+    if (pi->check_invariants)
+        emit_call(e, (uintptr_t) error_check);
+    emit_epilogue(e);
+    emit_patch_jump(e, skip);
+}
+
+// Can the JIT compile an instruction with the given handler?
+// (System calls and bad instructions are left to the interpreter.)
+static int jit_compilable(int handler) {
+    switch (handler) {
+        case pd_exit: case pd_pstr: case pd_pch: case pd_rch:
+        case pd_stra: case pd_notr: case pd_syscall: case pd_illegal:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Does the handler end a basic block (by changing PC)?
+static int jit_ends_block(int handler) {
+    switch (handler) {
+        case pd_beq: case pd_bgez: case pd_bgtz: case pd_blez:
+        case pd_bltz: case pd_bne: case pd_jmp: case pd_jal: case pd_jr:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Compile the block of vm's pre-decoded text that starts at word index:
+// the compilable instructions from there up to (and including) the first
+// one that changes PC, at most JIT_MAX_BLOCK of them. Return NULL if the
+// instruction at index is not compilable. Requires JIT_MAX_BLOCK_CODE bytes
+// free in jc's buffer.
+static jit_block jit_compile(jit_cache *jc, vm_state *vm, int index) {
+    jit_emitter e;
+    unsigned char *start = jc->code + jc->used;
+    const predecoded_instr_t *pi;
+    int i, next_pc = index * BYTES_PER_WORD;
+    int pending = 0;   // instructions not yet added to the count
+
+    if (!jit_compilable(vm->predecoded_text[index].handler))
+        return NULL;
+
+    e.p = start;
+    emit_prologue(&e);
+    for (i = index; i < jc->length && i < index + JIT_MAX_BLOCK; i++) {
+        pi = &vm->predecoded_text[i];
+        if (!jit_compilable(pi->handler))
+            break;
+        jc->covered[i] = 1;
+        next_pc = (i + 1) * BYTES_PER_WORD;
+        pending++;
+
+        switch (pi->handler) {
+            case pd_add: emit_reg_alu(&e, pi, X86_ADD_LOAD); break;
+            case pd_sub: emit_reg_alu(&e, pi, X86_SUB_LOAD); break;
+            case pd_and: emit_reg_alu(&e, pi, X86_AND_LOAD); break;
+            case pd_bor: emit_reg_alu(&e, pi, X86_OR_LOAD); break;
+            case pd_xor: emit_reg_alu(&e, pi, X86_XOR_LOAD); break;
+            case pd_nor:
+                emit_load(&e, RAX, GPR_OFFSET(pi->rs));
+                emit_field_op(&e, X86_OR_LOAD, RAX, GPR_OFFSET(pi->rt));
+                emit_reg_op(&e, X86_GROUP3, 2, RAX);
+                emit_store(&e, RAX, GPR_OFFSET(pi->rd));
+                break;
+            case pd_mul:
+                // edx:eax = eax * GPR[rt], the 64-bit product
+                emit_load(&e, RAX, GPR_OFFSET(pi->rs));
+                emit_field_op(&e, X86_GROUP3, 5, GPR_OFFSET(pi->rt));
+                emit_store(&e, RDX, HI_OFFSET);
+                emit_store(&e, RAX, LO_OFFSET);
+                break;
+            case pd_div:
+                // cdq, then eax = edx:eax / ecx (GPR[rt]), edx = the remainder
+                emit_load(&e, RAX, GPR_OFFSET(pi->rs));
+                emit_load(&e, RCX, GPR_OFFSET(pi->rt));
+                emit_division_check(&e, next_pc, pending);
+                emit_byte(&e, 0x99);
+                emit_reg_op(&e, X86_GROUP3, 7, RCX);
+                emit_store(&e, RDX, HI_OFFSET);
+                emit_store(&e, RAX, LO_OFFSET);
+                break;
+            case pd_mfhi:
+                emit_load(&e, RAX, HI_OFFSET);
+                emit_store(&e, RAX, GPR_OFFSET(pi->rd));
+                break;
+            case pd_mflo:
+                emit_load(&e, RAX, LO_OFFSET);
+                emit_store(&e, RAX, GPR_OFFSET(pi->rd));
+                break;
+            case pd_sll:
+            case pd_srl:
+                // SRL shifts arithmetically, as execute_instruction does
+                emit_load(&e, RAX, GPR_OFFSET(pi->rt));
+                emit_reg_op(&e, X86_SHIFT_IMM, pi->handler == pd_sll ? 4 : 7, RAX);
+                emit_byte(&e, pi->arg & 31);
+                emit_store(&e, RAX, GPR_OFFSET(pi->rd));
+                break;
+            case pd_addi: emit_immed_alu(&e, pi, 0); break;
+            case pd_bori: emit_immed_alu(&e, pi, 1); break;
+            case pd_andi: emit_immed_alu(&e, pi, 4); break;
+            case pd_xori: emit_immed_alu(&e, pi, 6); break;
+            case pd_lbu:
+                emit_add_counter(&e, LOADS_OFFSET, 1);
+                emit_address(&e, pi->rs, pi->arg);
+                emit_address_check(&e, 1, next_pc, pending);
+                emit_sign_extend(&e);
+                emit_byte(&e, 0x0F);   // movzx ecx, byte [memory + rax]
+                emit_memory_op(&e, 0xB6, RCX, 0);
+                emit_store(&e, RCX, GPR_OFFSET(pi->rt));
+                break;
+            case pd_lw:
+                emit_add_counter(&e, LOADS_OFFSET, 1);
+                emit_address(&e, pi->rs, pi->arg);
+                emit_address_check(&e, BYTES_PER_WORD, next_pc, pending);
+                emit_word_index(&e);
+                emit_sign_extend(&e);
+                emit_memory_op(&e, X86_MOV_LOAD, RCX, 2);
+                emit_store(&e, RCX, GPR_OFFSET(pi->rt));
+                break;
+            case pd_sb:
+                emit_add_counter(&e, STORES_OFFSET, 1);
+                emit_address(&e, pi->rs, pi->arg);
+                emit_address_check(&e, 1, next_pc, pending);
+                emit_sign_extend(&e);
+                emit_load(&e, RCX, GPR_OFFSET(pi->rt));
+                emit_memory_op(&e, 0x88, RCX, 0);   // mov byte [memory + rax], cl
+                emit_word_index(&e);
+                emit_store_refresh(&e, pi, jc->length, next_pc, pending);
+                break;
+            case pd_sw:
+                emit_add_counter(&e, STORES_OFFSET, 1);
+                emit_address(&e, pi->rs, pi->arg);
+                emit_address_check(&e, BYTES_PER_WORD, next_pc, pending);
+                emit_word_index(&e);
+                emit_sign_extend(&e);
+                emit_load(&e, RCX, GPR_OFFSET(pi->rt));
+                emit_memory_op(&e, X86_MOV_STORE, RCX, 2);
+                emit_store_refresh(&e, pi, jc->length, next_pc, pending);
+                break;
+            case pd_beq:
+            case pd_bne:
+                emit_load(&e, RAX, GPR_OFFSET(pi->rs));
+                emit_field_op(&e, X86_CMP_LOAD, RAX, GPR_OFFSET(pi->rt));
+                // skip with jne for BEQ, je for BNE
+                emit_branch(&e, pi, next_pc, pi->handler == pd_beq ? 0x75 : 0x74);
+                break;
+            case pd_bgez:
+            case pd_bgtz:
+            case pd_blez:
+            case pd_bltz:
+                emit_field_op(&e, X86_CMP_IMM8, 7, GPR_OFFSET(pi->rs));
+                emit_byte(&e, 0);
+                // skip with jl, jle, jg, or jge
+                emit_branch(&e, pi, next_pc,
+                            pi->handler == pd_bgez ? 0x7C
+                            : pi->handler == pd_bgtz ? 0x7E
+                            : pi->handler == pd_blez ? 0x7F : 0x7D);
+                break;
+            case pd_jmp:
+                emit_store_imm(&e, PC_OFFSET, pi->arg);
+                break;
+            case pd_jal:
+                emit_store_imm(&e, GPR_OFFSET(RA), next_pc);
+                emit_store_imm(&e, PC_OFFSET, pi->arg);
+                break;
+            case pd_jr:
+                emit_load(&e, RAX, GPR_OFFSET(pi->rs));
+                emit_store(&e, RAX, PC_OFFSET);
+                break;
+            default:
+                // pd_nop
+                break;
+        }
+
+        if (jit_ends_block(pi->handler)) {
+            // PC is already set, and every jump or branch is checked
+            emit_count(&e, pending);
+            emit_call(&e, (uintptr_t) error_check);
+            emit_epilogue(&e);
+            jc->used = e.p - jc->code;
+            return (jit_block) (void *) start;
+        }
+        if (pi->check_invariants) {
+            emit_error_check(&e, next_pc, pending);
+            pending = 0;
+        }
+    }
+
+    // The block ends before an instruction the interpreter has to run
+    // (or at the end of the text section, or of the longest block).
+    emit_store_imm(&e, PC_OFFSET, next_pc);
+    emit_count(&e, pending);
+    emit_epilogue(&e);
+    jc->used = e.p - jc->code;
+    return (jit_block) (void *) start;
+}
+
+// Forget all compiled code
+static void jit_flush(jit_cache *jc) {
+    jc->used = 0;
+    memset(jc->blocks, 0, jc->length * sizeof(jit_block));
+    memset(jc->heat, 0, jc->length);
+    memset(jc->covered, 0, jc->length);
+}
+
+// Make jc's code buffer writable (and not executable) if writable,
+// otherwise executable (and not writable), so it is never both
+static void jit_protect(jit_cache *jc, int writable) {
+    int prot = PROT_READ | (writable ? PROT_WRITE : PROT_EXEC);
+
+    if (mprotect(jc->code, JIT_CODE_SIZE, prot) != 0) {
+        bail_with_error("Cannot change the protection of the JIT's code");
+    }
+}
+
+// Return a new, empty cache for a text section of length pre-decoded words,
+// or NULL if no executable memory can be had.
+jit_cache *jit_create(int length) {
+    jit_cache *jc = (jit_cache *) calloc(1, sizeof(jit_cache));
+
+    if (jc == NULL) {
+        bail_with_error("Cannot allocate space for the JIT");
+    }
+    jc->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jc->code == MAP_FAILED) {
+        free(jc);
+        return NULL;
+    }
+    if (mprotect(jc->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        munmap(jc->code, JIT_CODE_SIZE);
+        free(jc);
+        return NULL;
+    }
+    jc->length = length;
+    jc->blocks = (jit_block *) calloc(length, sizeof(jit_block));
+    jc->heat = (unsigned char *) calloc(length, 1);
+    jc->covered = (unsigned char *) calloc(length, 1);
+    if (jc->blocks == NULL || jc->heat == NULL || jc->covered == NULL) {
+        bail_with_error("Cannot allocate space for the JIT");
+    }
+    return jc;
+}
+
+// Return the compiled block that starts at word index of vm's text section,
+// compiling it once the index has been reached JIT_THRESHOLD times,
+// or NULL if it is not compiled.
+jit_block jit_lookup(jit_cache *jc, vm_state *vm, int index) {
+    if (jc->blocks[index] != NULL)
+        return jc->blocks[index];
+    // once hot, a NULL block is one that cannot be compiled
+    if (jc->heat[index] >= JIT_THRESHOLD || ++jc->heat[index] < JIT_THRESHOLD)
+        return NULL;
+    if (jc->used + JIT_MAX_BLOCK_CODE > JIT_CODE_SIZE) {
+        jit_flush(jc);
+        jc->heat[index] = JIT_THRESHOLD;
+    }
+    jit_protect(jc, 1);
+    jc->blocks[index] = jit_compile(jc, vm, index);
+    jit_protect(jc, 0);
+    return jc->blocks[index];
+}
+
+// Forget the compiled code, if any, that contains the word at index.
+// All of it is flushed, as changing code is rare.
+// (This is safe while a block runs, as long as it returns right after,
+// since flushing does not change the code, and only jit_lookup writes more.)
+void jit_invalidate(jit_cache *jc, int index) {
+    if ((unsigned int) index < (unsigned int) jc->length && jc->covered[index])
+        jit_flush(jc);
+}
+
+// Free jc and its code
+void jit_destroy(jit_cache *jc) {
+    munmap(jc->code, JIT_CODE_SIZE);
+    free(jc->blocks);
+    free(jc->heat);
+    free(jc->covered);
+    free(jc);
+}
+
+#else
+
+// Without x86-64 code generation, there is never a cache,
+// so the other functions are never called.
+jit_cache *jit_create(int length) {
+    return NULL;
+}
+
+jit_block jit_lookup(jit_cache *jc, vm_state *vm, int index) {
+    return NULL;
+}
+
+void jit_invalidate(jit_cache *jc, int index) {
+}
+
+void jit_destroy(jit_cache *jc) {
+}
+
+#endif
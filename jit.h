@@ -0,0 +1,34 @@
+#ifndef _JIT_H
+#define _JIT_H
+
+#include "machine.h"
+
+// A compiled basic block: native code that runs the block's instructions
+// on vm (whose registers stay in the vm_state) and leaves PC at the
+// instruction to run next
+typedef void (*jit_block)(vm_state *vm);
+
+// The native code compiled for one VM, and how often each address was reached
+typedef struct jit_cache jit_cache;
+
+// Return a new, empty cache for a text section of length pre-decoded words,
+// or NULL if this host cannot run compiled code (it is not x86-64,
+// or no executable memory can be had), in which case nothing is compiled.
+extern jit_cache *jit_create(int length);
+
+// Requires: 0 <= index < the length jit_create was given,
+//           and vm's invariants hold (vm->invariants_checked)
+// Return the compiled block that starts at word index of vm's text section,
+// compiling it once the index has been reached often enough,
+// or NULL if it is not compiled (yet, or because its first instruction
+// has to be run by the interpreter).
+extern jit_block jit_lookup(jit_cache *jc, vm_state *vm, int index);
+
+// Forget the compiled code, if any, that contains the word at index,
+// which has been overwritten (to be called by predecode_refresh)
+extern void jit_invalidate(jit_cache *jc, int index);
+
+// Free jc and its code
+extern void jit_destroy(jit_cache *jc);
+
+#endif
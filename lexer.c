@@ -10,6 +10,8 @@
 #include "lexer.h"
 #include "machine_types.h"
 #include "utilities.h"
+#include "arena.h"
+#include "intern.h"
 
 
 // The input file's name
@@ -46,6 +48,24 @@ unsigned int lexer_line() {
     return yylineno;
 }
 
+// Requires: !lexer_done()
+// Return the file location of the token just read
+file_location lexer_location() {
+    return file_location_make(filename, yylineno);
+}
+
+// Requires: txt != NULL
+// Return a copy of the token text txt, allocated in the parse arena
+const char *lexer_text_copy(const char *txt) {
+    return arena_strdup(&parse_arena, txt);
+}
+
+// Requires: name != NULL
+// Return the interned copy of the identifier name
+const char *lexer_intern(const char *name) {
+    return intern(name);
+}
+
 // On standard output:
 // Print a message about the file name of the lexer's input
 // and then print a heading for the lexer's output.
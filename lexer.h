@@ -37,6 +37,21 @@ extern const char *lexer_filename();
 // Return the line number of the next token
 extern unsigned int lexer_line();
 
+// The following are used by the actions in asm_lexer.l
+// to make the ASTs of tokens
+
+// Requires: !lexer_done()
+// Return the file location of the token just read
+extern file_location lexer_location();
+
+// Requires: txt != NULL
+// Return a copy of the token text txt, allocated in the parse arena
+extern const char *lexer_text_copy(const char *txt);
+
+// Requires: name != NULL
+// Return the interned copy of the identifier name
+extern const char *lexer_intern(const char *name);
+
 // On standard output, print each token
 // using the format in lexer_print_token
 extern void lexer_output();
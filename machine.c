@@ -1,479 +1,1905 @@
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <setjmp.h>
+#include <time.h>
 #include "bof.h"
 #include "instruction.h"
 #include "machine_types.h"
 #include "regname.h"
 #include "utilities.h"
+#include "predecode.h"
+#include "tracebuf.h"
+#include "bintrace.h"
 #include "machine.h"
+#include "snapshot.h"
+#include "cow.h"
+#include "jit.h"
+
+// Make the new (zeroed) vm read from in and write to out, and start it running
+static void vm_attach_files(vm_state *vm, FILE *in, FILE *out) {
+    vm->in = in;
+    vm->out = out;
+    tracebuf_init(&vm->tracebuf, out);
+    vm->status = vm_running;
+    vm->write_log_overflowed = 1;
+}
+
+// Return a new VM, with all memory and registers zero, that reads from in
+// and writes to out, using the decoded engine and none of the other options.
+// Exit with an error if there is not enough memory for it.
+vm_state *vm_create(FILE *in, FILE *out) {
+    vm_state *vm = (vm_state *) calloc(1, sizeof(vm_state));
+    if (vm == NULL) {
+        bail_with_error("Cannot allocate space for a VM");
+    }
+
+    vm->engine = engine_decoded;
+    vm_attach_files(vm, in, out);
+    return vm;
+}
+
+// Stop vm with an error: format the message (like printf) into vm's
+// error_message and either exit with it (if vm->exit_on_error)
+// or return to the vm_load, vm_step, or vm_run that was running
+// with status vm_failed. Does not return.
+void vm_fail(vm_state *vm, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(vm->error_message, VM_ERROR_MESSAGE_SIZE, fmt, args);
+    va_end(args);
+    vm->status = vm_failed;
+    if (vm->exit_on_error) {
+        bail_with_error("%s", vm->error_message);
+    }
+    longjmp(vm->on_error, 1);
+}
+
+// Stop vm with an error for an access to the size bytes at byte address
+// addr, which are not all in memory. Does not return.
+// (Also called by the JIT's compiled loads and stores.)
+void vm_memory_fault(vm_state *vm, word_type addr, word_type size) {
+    vm_fail(vm, "The %d bytes at address %d are not all in memory", size, addr);
+}
 
-// Define an array for 32 general-purpose registers and variables for PC, HI, LO, and trace.
-word_type GPR[32];
-int PC, HI, LO;
-int trace;
+// Fail unless the size bytes at byte address addr are all in memory.
+// Every load, store, and system call that reaches memory checks this
+// first: memory is the first field of the vm_state, so an access past it
+// would reach the rest of the VM (and the host's memory).
+static inline void check_address(vm_state *vm, word_type addr, word_type size) {
+    if (addr < 0 || size < 0 || size > MEMORY_SIZE_IN_BYTES - addr)
+        vm_memory_fault(vm, addr, size);
+}
+
+// Stop vm with an error for dividing dividend by divisor, which is 0,
+// or -1 with dividend the most negative word (an overflow).
+// Does not return. (Also called by the JIT's compiled divisions.)
+void vm_division_fault(vm_state *vm, word_type dividend, word_type divisor) {
+    if (divisor == 0)
+        vm_fail(vm, "Division by zero");
+    vm_fail(vm, "Overflow dividing %d by %d", dividend, divisor);
+}
+
+// Fail unless dividend can be divided by divisor (as DIV does)
+static inline void check_division(vm_state *vm, word_type dividend, word_type divisor) {
+    if (divisor == 0 || (divisor == -1 && dividend == INT_MIN))
+        vm_division_fault(vm, dividend, divisor);
+}
+
+// Return the name of the section of the program described by bof_header
+// that does not fit in memory, or NULL if both fit
+static const char *section_not_fitting(BOFHeader bof_header) {
+    int text_words = bof_header.text_length / BYTES_PER_WORD;
+    int data_words = bof_header.data_length / BYTES_PER_WORD;
+    int data_index = bof_header.data_start_address / BYTES_PER_WORD;
+
+    if (text_words < 0 || text_words > MEMORY_SIZE_IN_WORDS) {
+        return "text";
+    }
+    if (data_words < 0 || (data_words > 0 && (bof_header.data_start_address < 0
+                                              || data_words > MEMORY_SIZE_IN_WORDS - data_index))) {
+        return "data";
+    }
+    return NULL;
+}
 
-// Define the main function to execute the virtual machine.
-int main(int argc, char **argv) {
-    int index;
-    bin_instr_t instruction;
+// Requires: nothing has been loaded into vm
+// Load the BOF file named filename into vm and set vm's registers to start it.
+// Return vm's status: vm_running, or vm_failed if filename cannot be read
+// as a BOF file or the program does not fit.
+vm_status vm_load(vm_state *vm, const char *filename) {
+    BOFMAP bof_map;
     BOFFILE bof_file;
-    BOFHeader bof_header;
+    const char *section = NULL;
+    const char *problem = NULL;
+    char error[VM_ERROR_MESSAGE_SIZE];
+    int mapped;
 
-    // Check for the correct number of command-line arguments.
-    if (argc != 2 && argc != 3) {
-        fprintf(stderr, "Missing arguments\n");
-        exit(0);
+    if (setjmp(vm->on_error) != 0) {
+        return vm->status;
     }
 
-    // If the -p flag is provided, set the index accordingly.
-    index = argc == 3 ? 2 : 1;
+    // Map the BOF file and copy its sections into memory in bulk,
+    // or, if it cannot be mapped, read its header and sections with stdio.
+    mapped = bof_map_open(filename, &bof_map, error, sizeof(error));
+    if (mapped < 0) {
+        vm_fail(vm, "%s", error);
+    } else if (mapped) {
+        vm->bof_header = bof_map.header;
+        section = section_not_fitting(vm->bof_header);
+        if (section == NULL) {
+            load_mapped_sections(vm, bof_map);
+        }
+        bof_map_close(bof_map);
+    } else {
+        bof_file.filename = filename;
+        bof_file.fileptr = fopen(filename, "rb");
+        if (bof_file.fileptr == NULL) {
+            vm_fail(vm, "Error opening file for reading: %s", filename);
+        }
+        if (bof_read_bytes(bof_file, sizeof(BOFHeader), &vm->bof_header) != 1) {
+            problem = "Cannot read header from %s";
+        } else if (strncmp(vm->bof_header.magic, "BOF", MAGIC_BUFFER_SIZE) != 0) {
+            problem = "File %s is not a BOF format file, bad magic number!";
+        } else {
+            section = section_not_fitting(vm->bof_header);
+            if (section == NULL && !(load_instruction_section(vm, bof_file)
+                                     && load_data_section(vm, bof_file))) {
+                problem = "File %s is too short for the sections in its header";
+            }
+        }
+        bof_close(bof_file);
+        if (problem != NULL) {
+            vm_fail(vm, problem, filename);
+        }
+    }
+    if (section != NULL) {
+        vm_fail(vm, "The %s section of %s does not fit in memory", section, filename);
+    }
 
-    // Open the BOF file and read its header.
-    bof_file = bof_read_open(argv[index]);
-    bof_header = bof_read_header(bof_file);
+    // Set initial register values, and decode the text section once,
+    // so the engines do not re-decode it.
+    set_registers(vm);
+    predecode_text_section(vm);
+    return vm->status;
+}
 
-    // Load the instruction and data sections from the BOF file.
-    load_instruction_section(bof_header, bof_file);
-    load_data_section(bof_header, bof_file);
+// Requires: nothing has been loaded into vm
+// Load the snapshot in the file named filename into vm, so that running vm
+// resumes the program where the snapshot was taken.
+// Return vm's status: vm_running, or vm_failed if filename cannot be read
+// as a snapshot or the program does not fit.
+vm_status vm_resume(vm_state *vm, const char *filename) {
+    const char *section;
+    char error[VM_ERROR_MESSAGE_SIZE];
+
+    if (setjmp(vm->on_error) != 0) {
+        return vm->status;
+    }
 
-    // Set initial register values.
-    set_registers(bof_header);
+    if (!snapshot_read(vm, filename, error, sizeof(error))) {
+        vm_fail(vm, "%s", error);
+    }
+    section = section_not_fitting(vm->bof_header);
+    if (section != NULL) {
+        vm_fail(vm, "The %s section of %s does not fit in memory", section, filename);
+    }
 
-    // If the program is run with -p flag, print the assembly instructions and data sections.
-    if (strcmp(argv[1], "-p") == 0) {
-        print_instruction_section(bof_header);
-        print_data_section(bof_header);
-        return 0;
+    // The text section may have been changed by the program, so it is
+    // decoded from memory as it is now.
+    predecode_text_section(vm);
+    return vm->status;
+}
+
+// Write a snapshot of vm to the file named filename
+// (exits with an error if the file cannot be written)
+void vm_write_snapshot(vm_state *vm, const char *filename) {
+    vm_flush_output(vm);
+    snapshot_write(vm, filename);
+}
+
+// Make base the base that vm_fork copies, putting its memory in an image
+// (if memory can be shared copy-on-write on this host)
+void vm_share(vm_state *base) {
+    if (base->image == NULL)
+        base->image = cow_image_create(&base->memory, sizeof(base->memory));
+}
+
+// Return a new VM, reading from in and writing to out, that starts where
+// base is, with base's memory shared copy-on-write (if base has an image).
+// Exit with an error if there is not enough memory for it.
+vm_state *vm_fork(const vm_state *base, FILE *in, FILE *out) {
+    size_t shared = 0;
+    vm_state *vm = NULL;
+
+    // memory comes first in a vm_state, so the image can be mapped
+    // at the start of a page aligned one
+    if (base->image != NULL && offsetof(vm_state, memory) == 0)
+        vm = (vm_state *) cow_map(base->image, sizeof(vm_state));
+    if (vm != NULL) {
+        vm->mapped = 1;
+        shared = cow_image_size(base->image);
+    } else {
+        vm = (vm_state *) calloc(1, sizeof(vm_state));
+        if (vm == NULL) {
+            bail_with_error("Cannot allocate space for a VM");
+        }
+    }
+    // the part of memory after the image's last whole page is copied
+    memcpy(&vm->memory.bytes[shared], &base->memory.bytes[shared],
+           sizeof(vm->memory) - shared);
+    vm_attach_files(vm, in, out);
+
+    vm->engine = base->engine;
+    vm->fast_mode = base->fast_mode;
+    vm->delta_trace = base->delta_trace;
+    vm->exit_on_error = base->exit_on_error;
+    memcpy(vm->GPR, base->GPR, sizeof(vm->GPR));
+    vm->PC = base->PC;
+    vm->HI = base->HI;
+    vm->LO = base->LO;
+    vm->trace = base->trace;
+    vm->bof_header = base->bof_header;
+    vm->instruction_count = base->instruction_count;
+
+    // the pre-decoded text is copied, as the program may change its text
+    vm->predecoded_length = base->predecoded_length;
+    vm->predecoded_text = (predecoded_instr_t *) malloc(vm->predecoded_length * sizeof(predecoded_instr_t));
+    if (vm->predecoded_text == NULL) {
+        bail_with_error("Cannot allocate space for the pre-decoded text section");
+    }
+    memcpy(vm->predecoded_text, base->predecoded_text,
+           vm->predecoded_length * sizeof(predecoded_instr_t));
+    return vm;
+}
+
+// Has vm executed the instructions it may before vm_run stops?
+static inline int stop_reached(const vm_state *vm) {
+    return vm->stop_count != 0 && vm->instruction_count >= vm->stop_count;
+}
+
+// Execute the instruction at PC (tracing it if the trace flag is set)
+// and return vm's status afterwards. Does nothing unless vm is running.
+vm_status vm_step(vm_state *vm) {
+    if (setjmp(vm->on_error) != 0) {
+        return vm->status;
+    }
+    if (vm->status == vm_running && vm->PC > vm->bof_header.text_length) {
+        vm->status = vm_halted;
+    }
+    if (vm->status != vm_running) {
+        return vm->status;
+    }
+
+    if (!vm->trace)
+        vm->write_log_overflowed = 1;
+    execute_step(vm);
+    if (vm->status == vm_running && vm->PC > vm->bof_header.text_length) {
+        vm->status = vm_halted;
+    }
+    return vm->status;
+}
+
+// Return the wall-clock time, in seconds
+static double now_seconds() {
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Add the time of the vm_run that is finishing to vm's run time
+static void vm_run_finished(vm_state *vm) {
+    vm->run_seconds += now_seconds() - vm->run_started;
+    vm->run_started = 0;
+}
+
+// Return the wall-clock time vm has spent running (in vm_run), in seconds,
+// including the vm_run in progress (if any)
+double vm_run_seconds(vm_state *vm) {
+    if (vm->run_started != 0)
+        return vm->run_seconds + (now_seconds() - vm->run_started);
+    return vm->run_seconds;
+}
+
+// Run vm until it exits, PC leaves the text section, or there is an error,
+// or until it reaches vm->stop_count instructions (if that is not 0),
+// then write out any buffered output and return vm's status.
+vm_status vm_run(vm_state *vm) {
+    vm->run_started = now_seconds();
+    if (setjmp(vm->on_error) != 0) {
+        vm_run_finished(vm);
+        vm_flush_output(vm);
+        return vm->status;
     }
 
     // Main execution loop for processing instructions.
-    while (PC <= bof_header.text_length) {
-        instruction = memory.instrs[PC / 4];
+    // The threaded and JIT engines only run while tracing is off,
+    // traced instructions are executed one at a time.
+    // Neither one profiles, so while profiling they execute_step instead.
+    while (vm->status == vm_running && vm->PC <= vm->bof_header.text_length
+           && !stop_reached(vm)) {
+        if (!vm->trace)
+            vm->write_log_overflowed = 1;
+        if (vm->engine == engine_threaded && !vm->trace && vm->invariants_checked
+            && vm->profile == NULL)
+            run_threaded(vm);
+        else if (vm->engine == engine_jit && !vm->trace && vm->invariants_checked
+                 && vm->profile == NULL)
+            run_jit(vm);
+        else
+            execute_step(vm);
+    }
+    if (vm->status == vm_running && vm->PC > vm->bof_header.text_length) {
+        vm->status = vm_halted;
+    }
 
-        // If the trace flag is set, print the current instruction and register values.
-        if (trace) {
-            print_registers(bof_header);
-            printf("==> addr: %d %s\n", PC, instruction_assembly_form(instruction));
-        }
+    vm_run_finished(vm);
+    vm_flush_output(vm);
+    return vm->status;
+}
+
+// Write out vm's buffered output (what the program printed and its trace)
+// to its output file
+void vm_flush_output(vm_state *vm) {
+    tracebuf_flush(&vm->tracebuf);
+}
+
+// Write s to out as a JSON string
+static void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if ((unsigned char) *s < ' ')
+            fprintf(out, "\\u%04x", *s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
 
-        PC += BYTES_PER_WORD;
-        execute_instruction(instruction);
-        error_check();
+// Write a summary of vm's run (its status and counts, the time it ran,
+// and the instructions executed per second) to out, as a JSON object
+// on one line. program is the name of the BOF file vm runs.
+void vm_write_summary(vm_state *vm, const char *program, FILE *out) {
+    static const char *status_names[] = {
+        [vm_running] = "running", [vm_exited] = "exited",
+        [vm_halted] = "halted", [vm_failed] = "failed"
+    };
+    static const char *engine_names[] = {
+        [engine_switch] = "switch", [engine_decoded] = "decoded",
+        [engine_threaded] = "threaded", [engine_jit] = "jit"
+    };
+    double seconds = vm_run_seconds(vm);
+
+    fprintf(out, "{\"program\": ");
+    write_json_string(out, program);
+    fprintf(out, ", \"engine\": \"%s\", \"status\": \"%s\"",
+            engine_names[vm->engine], status_names[vm->status]);
+    if (vm->status == vm_failed) {
+        fprintf(out, ", \"error\": ");
+        write_json_string(out, vm->error_message);
     }
+    fprintf(out, ", \"instructions\": %llu, \"loads\": %llu, \"stores\": %llu"
+            ", \"taken_branches\": %llu, \"syscalls\": %llu",
+            vm->instruction_count, vm->loads, vm->stores,
+            vm->taken_branches, vm->syscalls);
+    fprintf(out, ", \"seconds\": %.6f, \"instructions_per_second\": %.0f}\n",
+            seconds, seconds > 0 ? vm->instruction_count / seconds : 0.0);
+    fflush(out);
+}
 
-    return 0;
+// Write vm's trace to a new binary trace file named filename
+// instead of as text (exits with an error if the file cannot be opened)
+void vm_write_binary_trace(vm_state *vm, const char *filename) {
+    vm->bintrace_file = bintrace_write_open(filename, vm->bof_header);
+    vm->bintrace_writing = 1;
 }
 
+// Record the input vm reads and the output it writes in a new I/O log
+// file named filename (exits with an error if the file cannot be opened)
+void vm_record_io(vm_state *vm, const char *filename) {
+    vm->iolog_file = iolog_write_open(filename);
+    vm->iolog = iolog_recording;
+}
+
+// Read the next event of the I/O log vm is replaying into vm->iolog_next,
+// failing if the log is corrupt
+static void iolog_advance(vm_state *vm) {
+    char error[VM_ERROR_MESSAGE_SIZE];
+    int read = iolog_read_event(vm->iolog_file, &vm->iolog_next, error, sizeof(error));
+
+    if (read < 0) {
+        vm_fail(vm, "%s", error);
+    }
+    vm->iolog_replay_ended = read == 0;
+}
+
+// Replay the I/O log in the file named filename as vm runs, starting with
+// the first event at or after vm's instruction count.
+// Return vm's status: vm_failed if the file cannot be read as an I/O log.
+vm_status vm_replay_io(vm_state *vm, const char *filename) {
+    char error[VM_ERROR_MESSAGE_SIZE];
+
+    if (setjmp(vm->on_error) != 0) {
+        return vm->status;
+    }
+
+    if (!iolog_read_open(filename, &vm->iolog_file, error, sizeof(error))) {
+        vm_fail(vm, "%s", error);
+    }
+    vm->iolog = iolog_replaying;
+    do {
+        iolog_advance(vm);
+    } while (!vm->iolog_replay_ended && vm->iolog_next.count < vm->instruction_count);
+    return vm->status;
+}
+
+// Requires: vm is replaying an I/O log
+// Fail unless the next event of the log is one with tag at the current
+// instruction count (the system call that is running)
+static void iolog_expect(vm_state *vm, int tag) {
+    if (vm->iolog_replay_ended) {
+        vm_fail(vm, "The I/O log ends before the system call after %llu instructions",
+                vm->instruction_count);
+    }
+    if (vm->iolog_next.tag != tag || vm->iolog_next.count != vm->instruction_count) {
+        vm_fail(vm, "The I/O log does not match the system call after %llu instructions",
+                vm->instruction_count);
+    }
+}
+
+// Run RCH: read a character into GPR[2], from vm's input,
+// or from the I/O log when replaying one
+static void syscall_read_char(vm_state *vm) {
+    // a prompt the program printed has to be out before it waits for input
+    tracebuf_flush(&vm->tracebuf);
+    fflush(vm->out);
+    if (vm->iolog == iolog_replaying) {
+        iolog_expect(vm, IOLOG_READ);
+        vm->GPR[2] = vm->iolog_next.result;
+        iolog_advance(vm);
+        return;
+    }
+    vm->GPR[2] = getc(vm->in);
+    if (vm->iolog == iolog_recording)
+        iolog_write_read(vm->iolog_file, vm->instruction_count, vm->GPR[2]);
+}
+
+// Log (or check against the log being replayed) that a system call
+// wrote the length bytes at bytes and returned GPR[2]
+static void log_output(vm_state *vm, const char *bytes, size_t length) {
+    if (vm->iolog == iolog_recording) {
+        iolog_write_output(vm->iolog_file, vm->instruction_count, vm->GPR[2], bytes, length);
+    } else {
+        iolog_expect(vm, IOLOG_WRITE);
+        if (vm->iolog_next.length != length || memcmp(vm->iolog_next.bytes, bytes, length) != 0) {
+            vm_fail(vm, "The output after %llu instructions is not what the I/O log has",
+                    vm->instruction_count);
+        }
+        vm->GPR[2] = vm->iolog_next.result;
+        iolog_advance(vm);
+    }
+}
+
+// Run PSTR: print the string at word GPR[4] of memory,
+// with what printing returned in GPR[2]
+static void syscall_print_str(vm_state *vm) {
+    word_type index = vm->GPR[4];
+    if (index < 0 || index >= MEMORY_SIZE_IN_WORDS)
+        vm_memory_fault(vm, (word_type) ((unsigned) index * BYTES_PER_WORD), 1);
+    const char *s = (char *) &vm->memory.words[index];
+    size_t room = MEMORY_SIZE_IN_BYTES - index * BYTES_PER_WORD;
+    const char *end = memchr(s, '\0', room);
+    if (end == NULL)
+        // the string does not end before the end of memory
+        vm_memory_fault(vm, index * BYTES_PER_WORD, room + 1);
+    size_t length = end - s;
+
+    tracebuf_put_bytes(&vm->tracebuf, s, length);
+    vm->GPR[2] = length;
+    if (vm->iolog != iolog_none)
+        log_output(vm, s, length);
+}
+
+// Run PCH: print the character in GPR[4], with what printing returned in GPR[2]
+static void syscall_print_char(vm_state *vm) {
+    char c = (char) vm->GPR[4];
+
+    tracebuf_putc(&vm->tracebuf, c);
+    vm->GPR[2] = (unsigned char) c;
+    if (vm->iolog != iolog_none)
+        log_output(vm, &c, 1);
+}
+
+// Run EXIT: stop the program
+static void syscall_exit(vm_state *vm) {
+    tracebuf_flush(&vm->tracebuf);
+    vm->status = vm_exited;
+}
+
+// Run STRA: start tracing
+static void syscall_start_tracing(vm_state *vm) {
+    tracebuf_flush(&vm->tracebuf);
+    vm->trace = 1;
+}
+
+// Run NOTR: stop tracing
+static void syscall_stop_tracing(vm_state *vm) {
+    vm->trace = 0;
+    tracebuf_flush(&vm->tracebuf);
+}
+
+// Flush vm's output, close its binary trace and I/O log (if any), and free vm
+// (the in and out files given to vm_create or vm_fork are left open,
+// and VMs forked from vm can still be used)
+void vm_destroy(vm_state *vm) {
+    vm_flush_output(vm);
+    if (vm->bintrace_writing) {
+        bof_close(vm->bintrace_file);
+    }
+    if (vm->iolog != iolog_none) {
+        bof_close(vm->iolog_file);
+        free(vm->iolog_next.bytes);
+    }
+    free(vm->predecoded_text);
+    free(vm->threaded_code);
+    if (vm->jit != NULL)
+        jit_destroy(vm->jit);
+    if (vm->profile != NULL)
+        profile_destroy(vm->profile);
+    if (vm->image != NULL)
+        cow_image_destroy(vm->image);
+    if (vm->mapped)
+        cow_unmap(vm, sizeof(vm_state));
+    else
+        free(vm);
+}
+
+// Execute the instruction at PC with the chosen engine (the decoded one
+// for the threaded and JIT engines), printing the trace first if the trace flag is set.
+void execute_step(vm_state *vm) {
+    int index = vm->PC / BYTES_PER_WORD;
+
+    // If the trace flag is set, print the current instruction and register values.
+    if (vm->trace) {
+        if (vm->bintrace_writing)
+            write_binary_trace_step(vm, vm->memory.instrs[index]);
+        else if (vm->delta_trace)
+            print_delta_trace_step(vm, vm->memory.instrs[index]);
+        else
+            print_trace_step(vm, vm->memory.instrs[index]);
+    }
+
+    if (vm->profile != NULL)
+        profile_count(vm->profile, index, vm->memory.instrs[index]);
+
+    vm->PC += BYTES_PER_WORD;
+    vm->instruction_count++;
+    if (vm->engine == engine_switch) {
+        execute_instruction(vm, vm->memory.instrs[index]);
+    } else if (vm->predecoded_text[index].fused != pf_none
+               && !vm->trace && vm->invariants_checked && vm->profile == NULL) {
+        // a fused pair, which is only checked after its second instruction
+        execute_fused_instrs(vm, &vm->predecoded_text[index]);
+        index++;
+    } else {
+        execute_predecoded_instr(vm, &vm->predecoded_text[index]);
+    }
+    if (vm->status != vm_running)
+        return;
+    if (!vm->fast_mode || !vm->invariants_checked || vm->predecoded_text[index].check_invariants)
+        error_check(vm);
+}
 
 // Function to load data from BOF file
-void load_data_section(BOFHeader bof_header, BOFFILE bof_file) {
+// (return whether the whole data section could be read)
+int load_data_section(vm_state *vm, BOFFILE bof_file) {
+    size_t bytes = (vm->bof_header.data_length / BYTES_PER_WORD) * BYTES_PER_WORD;
+
+    // Read the words of the data section into memory with a single read.
+    return bytes == 0
+        || bof_read_bytes(bof_file, bytes,
+                          &vm->memory.words[vm->bof_header.data_start_address / BYTES_PER_WORD]) == 1;
+}
+
+// Function to read instructions from BOF file
+// (return whether the whole text section could be read)
+int load_instruction_section(vm_state *vm, BOFFILE bof_file) {
+    size_t bytes = (vm->bof_header.text_length / BYTES_PER_WORD) * BYTES_PER_WORD;
+
+    // Read the instructions into memory with a single read
+    // (the instruction section starts at index 0 of the array)
+    return bytes == 0 || bof_read_bytes(bof_file, bytes, vm->memory.words) == 1;
+}
+
+// Copy the text and data sections of the mapped BOF file bm into memory
+// (with the same placement as load_instruction_section and load_data_section)
+void load_mapped_sections(vm_state *vm, BOFMAP bm) {
+    memcpy(vm->memory.words, bm.text,
+           (bm.header.text_length / BYTES_PER_WORD) * BYTES_PER_WORD);
+    memcpy(&vm->memory.words[bm.header.data_start_address / BYTES_PER_WORD], bm.data,
+           (bm.header.data_length / BYTES_PER_WORD) * BYTES_PER_WORD);
+}
+
+// Decode every word the main loop can fetch (those at addresses
+// 0 through text_length) into predecoded_text.
+void predecode_text_section(vm_state *vm) {
     int i;
 
-    // Read each word one by one into the memory union in the data section of memory.
-    for (i = 0; i < bof_header.data_length / BYTES_PER_WORD; i++) {
-        memory.words[(bof_header.data_start_address + i*4) / BYTES_PER_WORD] = bof_read_word(bof_file);
+    vm->predecoded_length = vm->bof_header.text_length / BYTES_PER_WORD + 1;
+    if (vm->predecoded_length > MEMORY_SIZE_IN_WORDS)
+        vm->predecoded_length = MEMORY_SIZE_IN_WORDS;
+    vm->predecoded_text = (predecoded_instr_t *) malloc(vm->predecoded_length * sizeof(predecoded_instr_t));
+    if (vm->predecoded_text == NULL) {
+        bail_with_error("Cannot allocate space for the pre-decoded text section");
     }
 
+    for (i = 0; i < vm->predecoded_length; i++) {
+        vm->predecoded_text[i] = predecode_instr(vm->memory.instrs[i], i * BYTES_PER_WORD);
+    }
+    for (i = 0; i < vm->predecoded_length; i++) {
+        predecode_fuse(vm->predecoded_text, vm->predecoded_length, i);
+    }
 }
 
-// Function to read instructions from BOF file
-void load_instruction_section(BOFHeader bof_header, BOFFILE bof_file) {
+// Return the index in threaded_labels of the handler for pi:
+// that of its fused pair, if it starts one, or else its own
+static int threaded_label_index(const predecoded_instr_t *pi) {
+    if (pi->fused != pf_none)
+        return pd_num_handlers + pi->fused;
+    return pi->handler;
+}
+
+// Record in the write log that memory.words[index] was written,
+// which only matters while writing a binary trace.
+static void log_memory_write(vm_state *vm, int index) {
+    if (vm->write_log_length < WRITE_LOG_SIZE && 0 <= index && index < MEMORY_SIZE_IN_WORDS)
+        vm->write_log[vm->write_log_length++] = index;
+    else
+        vm->write_log_overflowed = 1;
+}
+
+// Re-decode memory.instrs[index] if it is in the pre-decoded text,
+// to be called after a store so that self-modifying code keeps working.
+// (Also called by the JIT's compiled stores.)
+void predecode_refresh(vm_state *vm, int index) {
+    unsigned int i = (unsigned int) index;
+
+    if (i < (unsigned int) vm->predecoded_length) {
+        vm->predecoded_text[i] = predecode_instr(vm->memory.instrs[i], i * BYTES_PER_WORD);
+        // the word may start a fused pair, or end one
+        predecode_fuse(vm->predecoded_text, vm->predecoded_length, i);
+        if (i > 0)
+            predecode_fuse(vm->predecoded_text, vm->predecoded_length, i - 1);
+        if (vm->threaded_code != NULL) {
+            vm->threaded_code[i] = vm->threaded_labels[threaded_label_index(&vm->predecoded_text[i])];
+            if (i > 0)
+                vm->threaded_code[i - 1] =
+                    vm->threaded_labels[threaded_label_index(&vm->predecoded_text[i - 1])];
+        }
+        if (vm->jit != NULL)
+            jit_invalidate(vm->jit, i);
+    }
+}
+
+// Requires: the length bytes at byte address addr are in memory
+// Account for a system call writing those bytes, as for stores:
+// re-decode the words of the text section among them, and log the words
+// for the binary and delta traces
+static void syscall_wrote_bytes(vm_state *vm, int addr, int length) {
+    int first = addr / BYTES_PER_WORD;
+    int end = (addr + length + BYTES_PER_WORD - 1) / BYTES_PER_WORD;
     int i;
-    // Read each instruction one by one into the memory union in the instruction section
-    // (which starts at index 0 of the array)
-    for (i = 0; i < bof_header.text_length / BYTES_PER_WORD; i++) {
-        memory.instrs[i] = instruction_read(bof_file);
+
+    for (i = first; i < end && i < vm->predecoded_length; i++)
+        predecode_refresh(vm, i);
+    if (end - first > WRITE_LOG_SIZE) {
+        vm->write_log_overflowed = 1;
+        return;
+    }
+    for (i = first; i < end; i++)
+        log_memory_write(vm, i);
+}
+
+// Run READ: read $a1 bytes (or fewer, if vm's input ends first) into memory
+// at byte address $a0, with the number read in $v0. When replaying an I/O log
+// the bytes come from the log instead.
+static void syscall_read_bytes(vm_state *vm) {
+    word_type addr = vm->GPR[4];
+    word_type length = vm->GPR[5];
+    char *bytes;
+
+    check_address(vm, addr, length);
+    bytes = (char *) &vm->memory.bytes[addr];
+    // as for RCH, a prompt has to be out before the program waits for input
+    tracebuf_flush(&vm->tracebuf);
+    fflush(vm->out);
+    if (vm->iolog == iolog_replaying) {
+        iolog_expect(vm, IOLOG_READ_BYTES);
+        if (vm->iolog_next.length > (size_t) length) {
+            vm_fail(vm, "The input after %llu instructions is not what the I/O log has",
+                    vm->instruction_count);
+        }
+        memcpy(bytes, vm->iolog_next.bytes, vm->iolog_next.length);
+        vm->GPR[2] = vm->iolog_next.result;
+        syscall_wrote_bytes(vm, addr, vm->iolog_next.length);
+        iolog_advance(vm);
+        return;
+    }
+    vm->GPR[2] = fread(bytes, 1, length, vm->in);
+    if (vm->iolog == iolog_recording)
+        iolog_write_input(vm->iolog_file, vm->instruction_count, vm->GPR[2], bytes, vm->GPR[2]);
+    syscall_wrote_bytes(vm, addr, vm->GPR[2]);
+}
+
+// Run WRITE: write the $a1 bytes at byte address $a0 of memory,
+// with the number written in $v0
+static void syscall_write_bytes(vm_state *vm) {
+    word_type addr = vm->GPR[4];
+    word_type length = vm->GPR[5];
+    const char *bytes;
+
+    check_address(vm, addr, length);
+    bytes = (char *) &vm->memory.bytes[addr];
+    tracebuf_put_bytes(&vm->tracebuf, bytes, length);
+    vm->GPR[2] = length;
+    if (vm->iolog != iolog_none)
+        log_output(vm, bytes, length);
+}
+
+// Run MCPY: copy the $a2 bytes at byte address $a1 of memory to byte
+// address $a0 (the two may overlap), with $a0 in $v0, as C's memmove
+static void syscall_copy_bytes(vm_state *vm) {
+    word_type to = vm->GPR[4];
+    word_type from = vm->GPR[5];
+    word_type length = vm->GPR[6];
+
+    check_address(vm, to, length);
+    check_address(vm, from, length);
+    memmove(&vm->memory.bytes[to], &vm->memory.bytes[from], length);
+    syscall_wrote_bytes(vm, to, length);
+    vm->GPR[2] = to;
+}
+
+// Run MSET: set the $a2 bytes at byte address $a0 of memory to the low byte
+// of $a1, with $a0 in $v0, as C's memset
+static void syscall_set_bytes(vm_state *vm) {
+    word_type to = vm->GPR[4];
+    word_type length = vm->GPR[6];
+
+    check_address(vm, to, length);
+    memset(&vm->memory.bytes[to], (unsigned char) vm->GPR[5], length);
+    syscall_wrote_bytes(vm, to, length);
+    vm->GPR[2] = to;
+}
+
+// The system call table: the handlers of the system calls, indexed by code.
+// Codes are 20 bits, so it has two levels: a page of SYSCALL_PAGE_SIZE
+// handlers for each run of that many codes that has any handlers
+// (a NULL page, or a NULL handler, is a code that does nothing).
+// The built-in system calls are all on the first page.
+#define SYSCALL_PAGE_BITS 10
+#define SYSCALL_PAGE_SIZE (1 << SYSCALL_PAGE_BITS)
+#define SYSCALL_NUM_PAGES (VM_NUM_SYSCALL_CODES / SYSCALL_PAGE_SIZE)
+
+static vm_syscall_handler builtin_syscalls[SYSCALL_PAGE_SIZE] = {
+    [exit_sc] = syscall_exit, [print_str_sc] = syscall_print_str,
+    [print_char_sc] = syscall_print_char, [read_char_sc] = syscall_read_char,
+    [start_tracing_sc] = syscall_start_tracing, [stop_tracing_sc] = syscall_stop_tracing,
+    [read_bytes_sc] = syscall_read_bytes, [write_bytes_sc] = syscall_write_bytes,
+    [copy_bytes_sc] = syscall_copy_bytes, [set_bytes_sc] = syscall_set_bytes
+};
+static vm_syscall_handler *syscall_table[SYSCALL_NUM_PAGES] = { builtin_syscalls };
+
+// Return the handler of the system call with code (NULL if there is none)
+static inline vm_syscall_handler syscall_handler(unsigned int code) {
+    vm_syscall_handler *page = syscall_table[code >> SYSCALL_PAGE_BITS];
+
+    return page == NULL ? NULL : page[code & (SYSCALL_PAGE_SIZE - 1)];
+}
+
+// Run the system call with code through the system call table,
+// counting it, or do nothing if code has no handler
+static void run_syscall(vm_state *vm, unsigned int code) {
+    vm_syscall_handler handler = syscall_handler(code);
+
+    if (handler != NULL) {
+        vm->syscalls++;
+        handler(vm);
     }
+}
 
+// Make handler the handler of the system call with code, with mnemonic
+// as its name in traces and listings (exits with an error if code is
+// out of range or already has a handler or a mnemonic)
+void vm_register_syscall(unsigned int code, const char *mnemonic, vm_syscall_handler handler) {
+    vm_syscall_handler **page;
+
+    if (code >= VM_NUM_SYSCALL_CODES) {
+        bail_with_error("System call code %u is too large", code);
+    }
+    if (syscall_handler(code) != NULL || instruction_syscall_known(code)) {
+        bail_with_error("System call code %u is already in use", code);
+    }
+    page = &syscall_table[code >> SYSCALL_PAGE_BITS];
+    if (*page == NULL) {
+        *page = (vm_syscall_handler *) calloc(SYSCALL_PAGE_SIZE, sizeof(vm_syscall_handler));
+        if (*page == NULL) {
+            bail_with_error("Cannot allocate space for the system call table");
+        }
+    }
+    (*page)[code & (SYSCALL_PAGE_SIZE - 1)] = handler;
+    instruction_add_syscall_mnemonic(code, mnemonic);
 }
 
-// Prints the instructions in MIPS architecture to stdout
-void print_instruction_section(BOFHeader bof_header) {
+// Prints the instructions in MIPS architecture to vm's output
+void print_instruction_section(vm_state *vm) {
 
     int i;
 
     // Print a table heading for the instruction output.
-    instruction_print_table_heading(stdout);
+    instruction_print_table_heading(vm->out);
 
     // Iterate through the instructions in the text section of memory.
-    for (i = 0; i < bof_header.text_length / BYTES_PER_WORD; i++) {
+    for (i = 0; i < vm->bof_header.text_length / BYTES_PER_WORD; i++) {
         // Print the instruction's address (byte offset) and its assembly representation.
-        printf("%4d %s", i * 4, instruction_assembly_form(memory.instrs[i]));
-        newline(stdout);  // Print a newline to separate instructions.
+        fprintf(vm->out, "%4d %s", i * 4, instruction_assembly_form(vm->memory.instrs[i]));
+        newline(vm->out);  // Print a newline to separate instructions.
     }
 }
 
-// Prints the data section, formatted, to stdout
-void print_data_section(BOFHeader bof_header) 
+// Prints the data section, formatted, to vm's output (through the trace buffer)
+void print_data_section(vm_state *vm) 
 {
     int i;
 
     // Check if there is no data or the first byte of data is zero.
-    if (bof_header.data_length == 0 || memory.bytes[bof_header.data_start_address] == 0) {
+    if (vm->bof_header.data_length == 0 || vm->memory.bytes[vm->bof_header.data_start_address] == 0) {
         // If no data exists, print a message and return.
-        printf("    %4d: 0    ...\n", bof_header.data_start_address);
+        tracebuf_puts(&vm->tracebuf, "    ");
+        tracebuf_put_int_right(&vm->tracebuf, vm->bof_header.data_start_address, 4);
+        tracebuf_puts(&vm->tracebuf, ": 0    ...\n");
         return;
     }
 
-    printf("    ");  // Formatting: Start with an indentation.
+    tracebuf_puts(&vm->tracebuf, "    ");  // Formatting: Start with an indentation.
 
-    for (i = 0; i < bof_header.data_length / BYTES_PER_WORD; i++) {
+    for (i = 0; i < vm->bof_header.data_length / BYTES_PER_WORD; i++) {
         // Print the byte offset, data value, and format it accordingly.
-        printf("%4d: %d    ", bof_header.data_start_address + i * 4, memory.words[(bof_header.data_start_address + i * 4) / BYTES_PER_WORD]);
+        tracebuf_put_int_right(&vm->tracebuf, vm->bof_header.data_start_address + i * 4, 4);
+        tracebuf_puts(&vm->tracebuf, ": ");
+        tracebuf_put_int(&vm->tracebuf, vm->memory.words[(vm->bof_header.data_start_address + i * 4) / BYTES_PER_WORD]);
+        tracebuf_puts(&vm->tracebuf, "    ");
 
         // Check for an ellipsis (...) condition.
-        if (memory.words[(bof_header.data_start_address + i * 4) / BYTES_PER_WORD] == 0 &&
-            memory.words[(bof_header.data_start_address + (i - 1) * 4)] == 0) {
-            printf("...\n");
+        if (vm->memory.words[(vm->bof_header.data_start_address + i * 4) / BYTES_PER_WORD] == 0 &&
+            vm->memory.words[(vm->bof_header.data_start_address + (i - 1) * 4)] == 0) {
+            tracebuf_puts(&vm->tracebuf, "...\n");
             return;
         }
 
         if (i % 5 == 4) {
-            newline(stdout);  // Insert a newline after every 5 data entries.
-            printf("    ");    // Indentation for the next line.
+            tracebuf_puts(&vm->tracebuf, "\n    ");  // Insert a newline and indentation after every 5 data entries.
         }
     }
 
-    printf("%4d: 0    ...", bof_header.data_start_address + i * 4);  // Print ellipsis for the last data entry.
-    newline(stdout);
+    // Print ellipsis for the last data entry.
+    tracebuf_put_int_right(&vm->tracebuf, vm->bof_header.data_start_address + i * 4, 4);
+    tracebuf_puts(&vm->tracebuf, ": 0    ...\n");
 }
 
-// Initialize registers, program counter, and trace flag using BOFHeader data.
-void set_registers(BOFHeader bof_header) {
+// Initialize registers, program counter, and trace flag using vm's BOFHeader.
+void set_registers(vm_state *vm) {
 
     for (int i = 0; i < 32; i++) 
-        GPR[i] = 0;  // Initialize all general-purpose registers to zero.
+        vm->GPR[i] = 0;  // Initialize all general-purpose registers to zero.
     
 
-    GPR[GP] = bof_header.data_start_address; // Set the global pointer (GP).
-    GPR[FP] = GPR[SP] = bof_header.stack_bottom_addr;  // Set frame pointer (FP) and stack pointer (SP).
+    vm->GPR[GP] = vm->bof_header.data_start_address; // Set the global pointer (GP).
+    vm->GPR[FP] = vm->GPR[SP] = vm->bof_header.stack_bottom_addr;  // Set frame pointer (FP) and stack pointer (SP).
 
-    PC = bof_header.text_start_address;  // Set the program counter (PC).
-    trace = 1;  // Enable instruction tracing.
+    vm->PC = vm->bof_header.text_start_address;  // Set the program counter (PC).
+    vm->trace = 1;  // Enable instruction tracing.
 
 }
 
 // Execute an instruction based on its type, handling various instruction categories.
-void execute_instruction(bin_instr_t instruction) {
+void execute_instruction(vm_state *vm, bin_instr_t instruction) {
     // Determine the type of the instruction.
     instr_type type = instruction_type(instruction);
     
     switch (type) 
     {
         case reg_instr_type:
-            execute_reg_type_instr(instruction.reg); // Execute a register-type instruction.
+            execute_reg_type_instr(vm, instruction.reg); // Execute a register-type instruction.
             break;
         case syscall_instr_type:
-            execute_syscall_type_instr(instruction.syscall); // Execute a syscall-type instruction.
+            execute_syscall_type_instr(vm, instruction.syscall); // Execute a syscall-type instruction.
             break;
         case immed_instr_type:
-            execute_immed_type_instr(instruction.immed); // Execute an immediate-type instruction.
+            execute_immed_type_instr(vm, instruction.immed); // Execute an immediate-type instruction.
             break;
         case jump_instr_type:
-            execute_jump_type_instr(instruction.jump); // Execute a jump-type instruction.
+            execute_jump_type_instr(vm, instruction.jump); // Execute a jump-type instruction.
             break;
         default:
-            bail_with_error("Error reading instruction type"); // Handle an unknown instruction type.
+            vm_fail(vm, "Error reading instruction type"); // Handle an unknown instruction type.
             break;
     }
 }
 
+// Go to the pre-decoded branch instruction's target if the branch
+// (whose opcode is op) is taken, counting it, and count the outcome if profiling
+static void decoded_branch(vm_state *vm, const predecoded_instr_t *instruction,
+                           int op, int taken) {
+    if (taken) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    if (vm->profile != NULL)
+        profile_branch(vm->profile, op, taken);
+}
+
+// Execute a pre-decoded instruction, with PC already pointing to the next one.
+// This has the same effect as execute_instruction on the original binary instruction.
+void execute_predecoded_instr(vm_state *vm, const predecoded_instr_t *instruction) {
+    int addr;
+
+    switch (instruction->handler) {
+        case pd_add:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rs] + vm->GPR[instruction->rt];
+            break;
+        case pd_sub:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rs] - vm->GPR[instruction->rt];
+            break;
+        case pd_mul: {
+            long long int result = (long long)vm->GPR[instruction->rs] * vm->GPR[instruction->rt];
+            vm->HI = (int)(result >> 32);
+            vm->LO = (int)result;
+            break;
+        }
+        case pd_div:
+            check_division(vm, vm->GPR[instruction->rs], vm->GPR[instruction->rt]);
+            vm->HI = vm->GPR[instruction->rs] % vm->GPR[instruction->rt];
+            vm->LO = vm->GPR[instruction->rs] / vm->GPR[instruction->rt];
+            break;
+        case pd_mfhi:
+            vm->GPR[instruction->rd] = vm->HI;
+            break;
+        case pd_mflo:
+            vm->GPR[instruction->rd] = vm->LO;
+            break;
+        case pd_and:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rs] & vm->GPR[instruction->rt];
+            break;
+        case pd_bor:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rs] | vm->GPR[instruction->rt];
+            break;
+        case pd_xor:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rs] ^ vm->GPR[instruction->rt];
+            break;
+        case pd_nor:
+            vm->GPR[instruction->rd] = ~(vm->GPR[instruction->rs] | vm->GPR[instruction->rt]);
+            break;
+        case pd_sll:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rt] << instruction->arg;
+            break;
+        case pd_srl:
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rt] >> instruction->arg;
+            break;
+        case pd_jr:
+            vm->PC = vm->GPR[instruction->rs];
+            break;
+        case pd_exit:
+            vm->syscalls++;
+            syscall_exit(vm);
+            break;
+        case pd_pstr:
+            vm->syscalls++;
+            syscall_print_str(vm);
+            break;
+        case pd_pch:
+            vm->syscalls++;
+            syscall_print_char(vm);
+            break;
+        case pd_rch:
+            vm->syscalls++;
+            syscall_read_char(vm);
+            break;
+        case pd_stra:
+            vm->syscalls++;
+            syscall_start_tracing(vm);
+            break;
+        case pd_notr:
+            vm->syscalls++;
+            syscall_stop_tracing(vm);
+            break;
+        // immediates were sign- or zero-extended when decoding
+        case pd_addi:
+            vm->GPR[instruction->rt] = vm->GPR[instruction->rs] + instruction->arg;
+            break;
+        case pd_andi:
+            vm->GPR[instruction->rt] = vm->GPR[instruction->rs] & instruction->arg;
+            break;
+        case pd_bori:
+            vm->GPR[instruction->rt] = vm->GPR[instruction->rs] | instruction->arg;
+            break;
+        case pd_xori:
+            vm->GPR[instruction->rt] = vm->GPR[instruction->rs] ^ instruction->arg;
+            break;
+        case pd_beq:
+            decoded_branch(vm, instruction, BEQ_O, vm->GPR[instruction->rs] == vm->GPR[instruction->rt]);
+            break;
+        case pd_bgez:
+            decoded_branch(vm, instruction, BGEZ_O, vm->GPR[instruction->rs] >= 0);
+            break;
+        case pd_bgtz:
+            decoded_branch(vm, instruction, BGTZ_O, vm->GPR[instruction->rs] > 0);
+            break;
+        case pd_blez:
+            decoded_branch(vm, instruction, BLEZ_O, vm->GPR[instruction->rs] <= 0);
+            break;
+        case pd_bltz:
+            decoded_branch(vm, instruction, BLTZ_O, vm->GPR[instruction->rs] < 0);
+            break;
+        case pd_bne:
+            decoded_branch(vm, instruction, BNE_O, vm->GPR[instruction->rs] != vm->GPR[instruction->rt]);
+            break;
+        case pd_lbu:
+            vm->loads++;
+            addr = vm->GPR[instruction->rs] + instruction->arg;
+            check_address(vm, addr, 1);
+            vm->GPR[instruction->rt] = vm->memory.bytes[addr];
+            break;
+        case pd_lw:
+            vm->loads++;
+            addr = vm->GPR[instruction->rs] + instruction->arg;
+            check_address(vm, addr, BYTES_PER_WORD);
+            vm->GPR[instruction->rt] = vm->memory.words[addr / BYTES_PER_WORD];
+            break;
+        case pd_sb:
+            vm->stores++;
+            addr = vm->GPR[instruction->rs] + instruction->arg;
+            check_address(vm, addr, 1);
+            vm->memory.bytes[addr] = vm->GPR[instruction->rt];
+            predecode_refresh(vm, addr / BYTES_PER_WORD);
+            log_memory_write(vm, addr / BYTES_PER_WORD);
+            break;
+        case pd_sw:
+            vm->stores++;
+            addr = vm->GPR[instruction->rs] + instruction->arg;
+            check_address(vm, addr, BYTES_PER_WORD);
+            vm->memory.words[addr / BYTES_PER_WORD] = vm->GPR[instruction->rt];
+            predecode_refresh(vm, addr / BYTES_PER_WORD);
+            log_memory_write(vm, addr / BYTES_PER_WORD);
+            break;
+        case pd_jmp:
+            vm->PC = instruction->arg;
+            break;
+        case pd_jal:
+            vm->GPR[RA] = vm->PC;
+            vm->PC = instruction->arg;
+            break;
+        case pd_syscall:
+            run_syscall(vm, instruction->arg);
+            break;
+        case pd_nop:
+            break;
+        default:
+            vm_fail(vm, "Error reading instruction type");
+            break;
+    }
+}
+
+// Execute the fused pair of pre-decoded instructions that starts with
+// instruction (see predecode_fuse), with PC already pointing to the second.
+// Leaves PC (and the instruction count) as executing both would.
+void execute_fused_instrs(vm_state *vm, const predecoded_instr_t *instruction) {
+    const predecoded_instr_t *second = instruction + 1;
+
+    vm->PC += BYTES_PER_WORD;
+    vm->instruction_count++;
+    switch (instruction->fused) {
+        case pf_addi_bne:
+            vm->GPR[instruction->rt] = vm->GPR[instruction->rs] + instruction->arg;
+            if (vm->GPR[second->rs] != vm->GPR[second->rt]) {
+                vm->PC = second->arg;
+                vm->taken_branches++;
+            }
+            break;
+        case pf_mul_mflo: {
+            long long int result = (long long)vm->GPR[instruction->rs] * vm->GPR[instruction->rt];
+            vm->HI = (int)(result >> 32);
+            vm->LO = (int)result;
+            vm->GPR[second->rd] = vm->LO;
+            break;
+        }
+        case pf_lw_add: {
+            word_type addr = vm->GPR[instruction->rs] + instruction->arg;
+            vm->loads++;
+            check_address(vm, addr, BYTES_PER_WORD);
+            vm->GPR[instruction->rt] = vm->memory.words[addr / BYTES_PER_WORD];
+            vm->GPR[second->rd] = vm->GPR[second->rs] + vm->GPR[second->rt];
+            break;
+        }
+        case pf_add_pch:
+            vm->syscalls++;
+            vm->GPR[instruction->rd] = vm->GPR[instruction->rs] + vm->GPR[instruction->rt];
+            syscall_print_char(vm);
+            break;
+        default:
+            // not a fused pair, so not called
+            break;
+    }
+}
+
+// Print the line of the trace that shows instruction and its address (PC)
+static void print_trace_line(vm_state *vm, bin_instr_t instruction) {
+    // instruction_assembly_form exits on words that are not instructions,
+    // which only the vm program wants
+    if (!vm->exit_on_error) {
+        predecode_handler handler = predecode_instr(instruction, vm->PC).handler;
+        if (handler == pd_nop || handler == pd_illegal) {
+            vm_fail(vm, "Cannot trace the word at address %d, it is not an instruction", vm->PC);
+        }
+    }
+    // (formatting the instruction may bail, so do it before printing the line)
+    const char *assembly_form = instruction_assembly_form(instruction);
+    tracebuf_puts(&vm->tracebuf, "==> addr: ");
+    tracebuf_put_int(&vm->tracebuf, vm->PC);
+    tracebuf_putc(&vm->tracebuf, ' ');
+    tracebuf_puts(&vm->tracebuf, assembly_form);
+    tracebuf_putc(&vm->tracebuf, '\n');
+}
+
+// Print the trace of instruction, which is about to be executed at PC:
+// the registers and memory, then the instruction's address and assembly form.
+void print_trace_step(vm_state *vm, bin_instr_t instruction) {
+    print_registers(vm);
+    print_trace_line(vm, instruction);
+}
+
+// Report each register (with HI and LO numbered BINTRACE_HI and BINTRACE_LO)
+// and memory word that changed since the last traced step by calling
+// report_reg and report_word, and bring the record of that step up to date.
+static void report_traced_changes(vm_state *vm,
+                                  void (*report_reg)(vm_state *, int, word_type),
+                                  void (*report_word)(vm_state *, int, word_type)) {
+    int i;
+
+    for (i = 0; i < NUM_REGISTERS; i++) {
+        if (vm->GPR[i] != vm->traced_GPR[i]) {
+            report_reg(vm, i, vm->GPR[i]);
+            vm->traced_GPR[i] = vm->GPR[i];
+        }
+    }
+    if (vm->HI != vm->traced_HI) {
+        report_reg(vm, BINTRACE_HI, vm->HI);
+        vm->traced_HI = vm->HI;
+    }
+    if (vm->LO != vm->traced_LO) {
+        report_reg(vm, BINTRACE_LO, vm->LO);
+        vm->traced_LO = vm->LO;
+    }
+
+    if (vm->write_log_overflowed) {
+        for (i = 0; i < MEMORY_SIZE_IN_WORDS; i++) {
+            if (vm->memory.words[i] != vm->traced_memory.words[i]) {
+                report_word(vm, i, vm->memory.words[i]);
+                vm->traced_memory.words[i] = vm->memory.words[i];
+            }
+        }
+    } else {
+        for (i = 0; i < vm->write_log_length; i++) {
+            int index = vm->write_log[i];
+            if (vm->memory.words[index] != vm->traced_memory.words[index]) {
+                report_word(vm, index, vm->memory.words[index]);
+                vm->traced_memory.words[index] = vm->memory.words[index];
+            }
+        }
+    }
+    vm->write_log_length = 0;
+    vm->write_log_overflowed = 0;
+}
+
+// Write the changed register r (or HI or LO) to the binary trace
+static void write_changed_reg(vm_state *vm, int r, word_type value) {
+    bintrace_reg(vm->bintrace_file, r, value);
+}
+
+// Write the changed memory word with the given index to the binary trace
+static void write_changed_word(vm_state *vm, int index, word_type value) {
+    bintrace_word(vm->bintrace_file, index, value);
+}
+
+// Write the step for instruction, which is about to be executed at PC,
+// to the binary trace: PC and the instruction, then the registers
+// and memory words that changed since the last step written.
+void write_binary_trace_step(vm_state *vm, bin_instr_t instruction) {
+    wordAsInstr_t w;
+
+    w.bi = instruction;
+    bintrace_begin_step(vm->bintrace_file, vm->PC, w.w);
+    report_traced_changes(vm, write_changed_reg, write_changed_word);
+    bintrace_end_step(vm->bintrace_file);
+}
+
+// Print the changed register r (or HI or LO) for the delta trace
+static void print_changed_reg(vm_state *vm, int r, word_type value) {
+    tracebuf_puts(&vm->tracebuf, "    ");
+    if (r == BINTRACE_HI) {
+        tracebuf_puts(&vm->tracebuf, "HI: ");
+    } else if (r == BINTRACE_LO) {
+        tracebuf_puts(&vm->tracebuf, "LO: ");
+    } else {
+        tracebuf_puts(&vm->tracebuf, "GPR[");
+        tracebuf_puts(&vm->tracebuf, regname_get(r));
+        tracebuf_puts(&vm->tracebuf, "]: ");
+    }
+    tracebuf_put_int(&vm->tracebuf, value);
+}
+
+// Print the changed memory word with the given index for the delta trace
+// (all of a step's words go on one line, after the registers)
+static void print_changed_word(vm_state *vm, int index, word_type value) {
+    if (!vm->delta_words_printed) {
+        tracebuf_putc(&vm->tracebuf, '\n');
+        vm->delta_words_printed = 1;
+    }
+    tracebuf_puts(&vm->tracebuf, "    ");
+    tracebuf_put_int(&vm->tracebuf, index * BYTES_PER_WORD);
+    tracebuf_puts(&vm->tracebuf, ": ");
+    tracebuf_put_int(&vm->tracebuf, value);
+}
+
+// Print the delta trace of instruction, which is about to be executed at PC.
+// The first traced step is printed in full, like print_trace_step does;
+// after that, only PC and the registers and memory words that changed
+// since the previous traced step are printed before the instruction.
+void print_delta_trace_step(vm_state *vm, bin_instr_t instruction) {
+    if (!vm->delta_trace_started) {
+        vm->delta_trace_started = 1;
+        memcpy(vm->traced_GPR, vm->GPR, sizeof(vm->traced_GPR));
+        vm->traced_HI = vm->HI;
+        vm->traced_LO = vm->LO;
+        vm->traced_memory = vm->memory;
+        vm->write_log_length = 0;
+        vm->write_log_overflowed = 0;
+        print_trace_step(vm, instruction);
+        return;
+    }
+
+    tracebuf_puts(&vm->tracebuf, "      PC: ");
+    tracebuf_put_int(&vm->tracebuf, vm->PC);
+    vm->delta_words_printed = 0;
+    report_traced_changes(vm, print_changed_reg, print_changed_word);
+    tracebuf_putc(&vm->tracebuf, '\n');
+    print_trace_line(vm, instruction);
+}
+
+// Run pre-decoded instructions with direct threading (GCC labels as values):
+// each handler jumps straight to the label of the next instruction's handler
+// instead of going back through a switch. Returns when PC leaves the text
+// section, when tracing is turned on, or at the first jump or branch once
+// vm_run's stop_count is reached; the effects of each instruction
+// are the same as in execute_predecoded_instr.
+void run_threaded(vm_state *vm) {
+    static void *const labels[pd_num_handlers + pf_num_fusions] = {
+        [pd_add] = &&do_add, [pd_sub] = &&do_sub, [pd_mul] = &&do_mul,
+        [pd_div] = &&do_div, [pd_mfhi] = &&do_mfhi, [pd_mflo] = &&do_mflo,
+        [pd_and] = &&do_and, [pd_bor] = &&do_bor, [pd_xor] = &&do_xor,
+        [pd_nor] = &&do_nor, [pd_sll] = &&do_sll, [pd_srl] = &&do_srl,
+        [pd_jr] = &&do_jr, [pd_exit] = &&do_exit, [pd_pstr] = &&do_pstr,
+        [pd_pch] = &&do_pch, [pd_rch] = &&do_rch, [pd_stra] = &&do_stra,
+        [pd_notr] = &&do_notr, [pd_addi] = &&do_addi, [pd_andi] = &&do_andi,
+        [pd_bori] = &&do_bori, [pd_xori] = &&do_xori, [pd_beq] = &&do_beq,
+        [pd_bgez] = &&do_bgez, [pd_bgtz] = &&do_bgtz, [pd_blez] = &&do_blez,
+        [pd_bltz] = &&do_bltz, [pd_bne] = &&do_bne, [pd_lbu] = &&do_lbu,
+        [pd_lw] = &&do_lw, [pd_sb] = &&do_sb, [pd_sw] = &&do_sw,
+        [pd_jmp] = &&do_jmp, [pd_jal] = &&do_jal, [pd_syscall] = &&do_syscall,
+        [pd_nop] = &&do_nop, [pd_illegal] = &&do_illegal,
+        [pd_num_handlers] = &&do_done,  // the word after the text section
+        // fused pairs, indexed as threaded_label_index does
+        [pd_num_handlers + pf_addi_bne] = &&do_addi_bne,
+        [pd_num_handlers + pf_mul_mflo] = &&do_mul_mflo,
+        [pd_num_handlers + pf_lw_add] = &&do_lw_add,
+        [pd_num_handlers + pf_add_pch] = &&do_add_pch
+    };
+    const predecoded_instr_t *instruction;
+    int i, addr;
+
+    // Translate the handler indexes into label addresses the first time,
+    // with an extra entry so falling off the end needs no range check.
+    if (vm->threaded_code == NULL) {
+        vm->threaded_code = (void **) malloc((vm->predecoded_length + 1) * sizeof(void *));
+        if (vm->threaded_code == NULL) {
+            bail_with_error("Cannot allocate space for the threaded code");
+        }
+        for (i = 0; i < vm->predecoded_length; i++) {
+            vm->threaded_code[i] = labels[threaded_label_index(&vm->predecoded_text[i])];
+        }
+        vm->threaded_code[vm->predecoded_length] = labels[pd_num_handlers];
+        vm->threaded_labels = labels;
+    }
+
+// Fetch the instruction at PC and jump to its handler
+#define DISPATCH() \
+    do { \
+        i = vm->PC / BYTES_PER_WORD; \
+        instruction = &vm->predecoded_text[i]; \
+        vm->PC += BYTES_PER_WORD; \
+        vm->instruction_count++; \
+        goto *vm->threaded_code[i]; \
+    } while (0)
+// Finish an instruction that falls through to the next one
+#define NEXT() \
+    do { \
+        if (!vm->fast_mode || instruction->check_invariants) \
+            error_check(vm); \
+        DISPATCH(); \
+    } while (0)
+// Go on to the second instruction of a fused pair
+// (the first one cannot break an invariant, so it is not checked)
+#define SECOND() \
+    do { \
+        instruction++; \
+        vm->PC += BYTES_PER_WORD; \
+        vm->instruction_count++; \
+    } while (0)
+// Finish an instruction that may have changed PC
+// (vm_run's stop_count is only checked here, so every loop checks it)
+#define JUMPED() \
+    do { \
+        error_check(vm); \
+        if (vm->PC > vm->bof_header.text_length || stop_reached(vm)) \
+            return; \
+        DISPATCH(); \
+    } while (0)
+
+    DISPATCH();
+
+do_add:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] + vm->GPR[instruction->rt];
+    NEXT();
+do_sub:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] - vm->GPR[instruction->rt];
+    NEXT();
+do_mul: {
+    long long int result = (long long)vm->GPR[instruction->rs] * vm->GPR[instruction->rt];
+    vm->HI = (int)(result >> 32);
+    vm->LO = (int)result;
+    NEXT();
+}
+do_div:
+    check_division(vm, vm->GPR[instruction->rs], vm->GPR[instruction->rt]);
+    vm->HI = vm->GPR[instruction->rs] % vm->GPR[instruction->rt];
+    vm->LO = vm->GPR[instruction->rs] / vm->GPR[instruction->rt];
+    NEXT();
+do_mfhi:
+    vm->GPR[instruction->rd] = vm->HI;
+    NEXT();
+do_mflo:
+    vm->GPR[instruction->rd] = vm->LO;
+    NEXT();
+do_and:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] & vm->GPR[instruction->rt];
+    NEXT();
+do_bor:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] | vm->GPR[instruction->rt];
+    NEXT();
+do_xor:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] ^ vm->GPR[instruction->rt];
+    NEXT();
+do_nor:
+    vm->GPR[instruction->rd] = ~(vm->GPR[instruction->rs] | vm->GPR[instruction->rt]);
+    NEXT();
+do_sll:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rt] << instruction->arg;
+    NEXT();
+do_srl:
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rt] >> instruction->arg;
+    NEXT();
+do_jr:
+    vm->PC = vm->GPR[instruction->rs];
+    JUMPED();
+do_exit:
+    vm->syscalls++;
+    syscall_exit(vm);
+    return;
+do_pstr:
+    vm->syscalls++;
+    syscall_print_str(vm);
+    NEXT();
+do_pch:
+    vm->syscalls++;
+    syscall_print_char(vm);
+    NEXT();
+do_rch:
+    vm->syscalls++;
+    syscall_read_char(vm);
+    NEXT();
+do_stra:
+    vm->syscalls++;
+    // traced instructions go through execute_step
+    syscall_start_tracing(vm);
+    error_check(vm);
+    return;
+do_notr:
+    vm->syscalls++;
+    syscall_stop_tracing(vm);
+    NEXT();
+do_addi:
+    vm->GPR[instruction->rt] = vm->GPR[instruction->rs] + instruction->arg;
+    NEXT();
+do_andi:
+    vm->GPR[instruction->rt] = vm->GPR[instruction->rs] & instruction->arg;
+    NEXT();
+do_bori:
+    vm->GPR[instruction->rt] = vm->GPR[instruction->rs] | instruction->arg;
+    NEXT();
+do_xori:
+    vm->GPR[instruction->rt] = vm->GPR[instruction->rs] ^ instruction->arg;
+    NEXT();
+do_beq:
+    if (vm->GPR[instruction->rs] == vm->GPR[instruction->rt]) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_bgez:
+    if (vm->GPR[instruction->rs] >= 0) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_bgtz:
+    if (vm->GPR[instruction->rs] > 0) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_blez:
+    if (vm->GPR[instruction->rs] <= 0) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_bltz:
+    if (vm->GPR[instruction->rs] < 0) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_bne:
+    if (vm->GPR[instruction->rs] != vm->GPR[instruction->rt]) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_lbu:
+    vm->loads++;
+    addr = vm->GPR[instruction->rs] + instruction->arg;
+    check_address(vm, addr, 1);
+    vm->GPR[instruction->rt] = vm->memory.bytes[addr];
+    NEXT();
+do_lw:
+    vm->loads++;
+    addr = vm->GPR[instruction->rs] + instruction->arg;
+    check_address(vm, addr, BYTES_PER_WORD);
+    vm->GPR[instruction->rt] = vm->memory.words[addr / BYTES_PER_WORD];
+    NEXT();
+do_sb:
+    vm->stores++;
+    addr = vm->GPR[instruction->rs] + instruction->arg;
+    check_address(vm, addr, 1);
+    vm->memory.bytes[addr] = vm->GPR[instruction->rt];
+    predecode_refresh(vm, addr / BYTES_PER_WORD);
+    NEXT();
+do_sw:
+    vm->stores++;
+    addr = vm->GPR[instruction->rs] + instruction->arg;
+    check_address(vm, addr, BYTES_PER_WORD);
+    vm->memory.words[addr / BYTES_PER_WORD] = vm->GPR[instruction->rt];
+    predecode_refresh(vm, addr / BYTES_PER_WORD);
+    NEXT();
+do_jmp:
+    vm->PC = instruction->arg;
+    JUMPED();
+do_jal:
+    vm->GPR[RA] = vm->PC;
+    vm->PC = instruction->arg;
+    JUMPED();
+do_syscall:
+    run_syscall(vm, instruction->arg);
+    // an added system call can stop the program, start tracing, or jump
+    if (vm->status != vm_running || vm->trace) {
+        error_check(vm);
+        return;
+    }
+    JUMPED();
+do_nop:
+    NEXT();
+do_illegal:
+    vm_fail(vm, "Error reading instruction type");
+do_addi_bne:
+    vm->GPR[instruction->rt] = vm->GPR[instruction->rs] + instruction->arg;
+    SECOND();
+    if (vm->GPR[instruction->rs] != vm->GPR[instruction->rt]) {
+        vm->PC = instruction->arg;
+        vm->taken_branches++;
+    }
+    JUMPED();
+do_mul_mflo: {
+    long long int result = (long long)vm->GPR[instruction->rs] * vm->GPR[instruction->rt];
+    vm->HI = (int)(result >> 32);
+    vm->LO = (int)result;
+    SECOND();
+    vm->GPR[instruction->rd] = vm->LO;
+    NEXT();
+}
+do_lw_add:
+    vm->loads++;
+    addr = vm->GPR[instruction->rs] + instruction->arg;
+    check_address(vm, addr, BYTES_PER_WORD);
+    vm->GPR[instruction->rt] = vm->memory.words[addr / BYTES_PER_WORD];
+    SECOND();
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] + vm->GPR[instruction->rt];
+    NEXT();
+do_add_pch:
+    vm->syscalls++;
+    vm->GPR[instruction->rd] = vm->GPR[instruction->rs] + vm->GPR[instruction->rt];
+    SECOND();
+    syscall_print_char(vm);
+    NEXT();
+do_done:
+    // fell off the end of the text section, undo the fetch
+    vm->PC -= BYTES_PER_WORD;
+    vm->instruction_count--;
+    return;
+
+#undef DISPATCH
+#undef SECOND
+#undef NEXT
+#undef JUMPED
+}
+
+// Run compiled blocks where the JIT has them, and other instructions
+// one at a time with execute_step, until PC leaves the text section,
+// tracing is turned on, the program exits, or (after a block)
+// vm_run's stop_count is reached. Blocks are compiled once
+// their first address has been reached often enough, and contain no system
+// calls, so the interpreter runs those (and tracing, if turned on).
+// Without a JIT for this host, this runs the decoded engine instead.
+void run_jit(vm_state *vm) {
+    jit_block block;
+
+    if (vm->jit == NULL) {
+        vm->jit = jit_create(vm->predecoded_length);
+        if (vm->jit == NULL) {
+            vm->engine = engine_decoded;
+            return;
+        }
+    }
+
+    while (vm->status == vm_running && !vm->trace
+           && vm->PC <= vm->bof_header.text_length && !stop_reached(vm)) {
+        block = jit_lookup(vm->jit, vm, vm->PC / BYTES_PER_WORD);
+        if (block != NULL)
+            block(vm);
+        else
+            execute_step(vm);
+    }
+}
+
 // Execute a register-type instruction, performing arithmetic and logical operations.
-void execute_reg_type_instr(reg_instr_t instruction) {
+void execute_reg_type_instr(vm_state *vm, reg_instr_t instruction) {
     switch (instruction.func) {
         case ADD_F:
             // Add values of source registers and store the result in the destination register.
-            GPR[instruction.rd] = GPR[instruction.rs] + GPR[instruction.rt];
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rs] + vm->GPR[instruction.rt];
             break;
         case SUB_F:
             // Subtract values of source registers and store the result in the destination register.
-            GPR[instruction.rd] = GPR[instruction.rs] - GPR[instruction.rt];
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rs] - vm->GPR[instruction.rt];
             break;
         case MUL_F:
             // Multiply source registers using long long to handle overflow.
-            long long int result = (long long)GPR[instruction.rs] * GPR[instruction.rt]; 
+            long long int result = (long long)vm->GPR[instruction.rs] * vm->GPR[instruction.rt]; 
             // Extract and store the most significant and least significant bits.
-            HI = (int)(result >> 32); // Most significant bits
-            LO = (int)result;         // Least significant bits
+            vm->HI = (int)(result >> 32); // Most significant bits
+            vm->LO = (int)result;         // Least significant bits
             break;
         case DIV_F:
             // Divide source registers and store the quotient in LO and the remainder in HI.
-            HI = GPR[instruction.rs] % GPR[instruction.rt];
-            LO = GPR[instruction.rs] / GPR[instruction.rt];
+            check_division(vm, vm->GPR[instruction.rs], vm->GPR[instruction.rt]);
+            vm->HI = vm->GPR[instruction.rs] % vm->GPR[instruction.rt];
+            vm->LO = vm->GPR[instruction.rs] / vm->GPR[instruction.rt];
             break;
         case MFHI_F:
             // Move the value of HI to the destination register.
-            GPR[instruction.rd] = HI;
+            vm->GPR[instruction.rd] = vm->HI;
             break;
         case MFLO_F:
             // Move the value of LO to the destination register.
-            GPR[instruction.rd] = LO;
+            vm->GPR[instruction.rd] = vm->LO;
             break;
         case AND_F:
             // Perform a bitwise AND operation on source registers and store the result.
-            GPR[instruction.rd] = GPR[instruction.rs] & GPR[instruction.rt];
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rs] & vm->GPR[instruction.rt];
             break;
         case BOR_F:
             // Perform a bitwise OR operation on source registers and store the result.
-            GPR[instruction.rd] = GPR[instruction.rs] | GPR[instruction.rt];
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rs] | vm->GPR[instruction.rt];
             break;
         case XOR_F:
             // Perform a bitwise XOR operation on source registers and store the result.
-            GPR[instruction.rd] = GPR[instruction.rs] ^ GPR[instruction.rt];
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rs] ^ vm->GPR[instruction.rt];
             break;
         case NOR_F:
             // Perform a bitwise NOR operation on source registers and store the result.
-            GPR[instruction.rd] = ~(GPR[instruction.rs] | GPR[instruction.rt]);
+            vm->GPR[instruction.rd] = ~(vm->GPR[instruction.rs] | vm->GPR[instruction.rt]);
             break;
         case SLL_F:
             // Shift the value in the source register left by a specified number of bits.
-            GPR[instruction.rd] = GPR[instruction.rt] << instruction.shift;
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rt] << instruction.shift;
             break;
         case SRL_F:
             // Shift the value in the source register right by a specified number of bits.
-            GPR[instruction.rd] = GPR[instruction.rt] >> instruction.shift;
+            vm->GPR[instruction.rd] = vm->GPR[instruction.rt] >> instruction.shift;
             break;
         case JR_F:
             // Jump to the address in the source register.
-            PC = GPR[instruction.rs];
+            vm->PC = vm->GPR[instruction.rs];
             break;
     }
 }
 
-// Execute a syscall-type instruction, handling various system call operations.
-void execute_syscall_type_instr(syscall_instr_t instruction) {
-    switch (instruction.code) {
-        case exit_sc:
-            // Exit the program.
-            exit(0);
-            break;
-        case print_str_sc:
-            // Print a string from memory and store the result in GPR[2].
-            GPR[2] = printf("%s", (char *) &memory.words[GPR[4]]);
-            break;
-        case print_char_sc:
-            // Print a character and store the result in GPR[2].
-            GPR[2] = fputc(GPR[4], stdout);
-            break;
-        case read_char_sc:
-            // Read a character from stdin and store the result in GPR[2].
-            GPR[2] = getc(stdin);
-            break;
-        case start_tracing_sc:
-            // Enable instruction tracing.
-            trace = 1;
-            break;
-        case stop_tracing_sc:
-            // Disable instruction tracing.
-            trace = 0;
-            break;
+// Execute a syscall-type instruction through the system call table
+// (a code without a handler does nothing).
+void execute_syscall_type_instr(vm_state *vm, syscall_instr_t instruction) {
+    run_syscall(vm, instruction.code);
+}
+
+// Add the branch instruction's offset to PC if the branch is taken,
+// counting it, and count the outcome if profiling
+static void immed_branch(vm_state *vm, immed_instr_t instruction, int taken) {
+    if (taken) {
+        vm->PC = vm->PC + machine_types_formOffset(instruction.immed);
+        vm->taken_branches++;
     }
+    if (vm->profile != NULL)
+        profile_branch(vm->profile, instruction.op, taken);
 }
 
 // Execute an immediate-type instruction, performing operations based on the instruction type.
-void execute_immed_type_instr(immed_instr_t instruction) 
+void execute_immed_type_instr(vm_state *vm, immed_instr_t instruction) 
 {
     switch (instruction.op) {
         case ADDI_O:
             // Add a sign-extended immediate value to the source register and store the result.
-            GPR[instruction.rt] = GPR[instruction.rs] + machine_types_sgnExt(instruction.immed);
+            vm->GPR[instruction.rt] = vm->GPR[instruction.rs] + machine_types_sgnExt(instruction.immed);
             break;
         case ANDI_O:
             // Perform a bitwise AND operation with a zero-extended immediate value and store the result.
-            GPR[instruction.rt] = GPR[instruction.rs] & machine_types_zeroExt(instruction.immed);
+            vm->GPR[instruction.rt] = vm->GPR[instruction.rs] & machine_types_zeroExt(instruction.immed);
             break;
         case BORI_O:
             // Perform a bitwise OR operation with a zero-extended immediate value and store the result.
-            GPR[instruction.rt] = GPR[instruction.rs] | machine_types_zeroExt(instruction.immed);
+            vm->GPR[instruction.rt] = vm->GPR[instruction.rs] | machine_types_zeroExt(instruction.immed);
             break;
         case XORI_O:
             // Perform a bitwise XOR operation with a zero-extended immediate value and store the result.
-            GPR[instruction.rt] = GPR[instruction.rs] ^ machine_types_zeroExt(instruction.immed);
+            vm->GPR[instruction.rt] = vm->GPR[instruction.rs] ^ machine_types_zeroExt(instruction.immed);
             break;
         case BEQ_O:
             // Branch if the values in two source registers are equal.
-            if (GPR[instruction.rs] == GPR[instruction.rt]) {
-                PC = PC + machine_types_formOffset(instruction.immed);
-            }
+            immed_branch(vm, instruction, vm->GPR[instruction.rs] == vm->GPR[instruction.rt]);
             break;
         case BGEZ_O:
             // Branch if the value in a source register is greater than or equal to zero.
-            if (GPR[instruction.rs] >= 0) {
-                PC = PC + machine_types_formOffset(instruction.immed);
-            }
+            immed_branch(vm, instruction, vm->GPR[instruction.rs] >= 0);
             break;
         case BGTZ_O:
             // Branch if the value in a source register is greater than zero.
-            if (GPR[instruction.rs] > 0) {
-                PC = PC + machine_types_formOffset(instruction.immed);
-            }
+            immed_branch(vm, instruction, vm->GPR[instruction.rs] > 0);
             break;
         case BLEZ_O:
             // Branch if the value in a source register is less than or equal to zero.
-            if (GPR[instruction.rs] <= 0) {
-                PC = PC + machine_types_formOffset(instruction.immed);
-            }
+            immed_branch(vm, instruction, vm->GPR[instruction.rs] <= 0);
             break;
         case BLTZ_O:
             // Branch if the value in a source register is less than zero.
-            if (GPR[instruction.rs] < 0) {
-                PC = PC + machine_types_formOffset(instruction.immed);
-            }
+            immed_branch(vm, instruction, vm->GPR[instruction.rs] < 0);
             break;
         case BNE_O:
             // Branch if the values in two source registers are not equal.
-            if (GPR[instruction.rs] != GPR[instruction.rt]) {
-                PC = PC + machine_types_formOffset(instruction.immed);
-            }
+            immed_branch(vm, instruction, vm->GPR[instruction.rs] != vm->GPR[instruction.rt]);
             break;
         case LBU_O:
             // Load a byte from memory, zero-extend it, and store it in the destination register.
-            GPR[instruction.rt] = machine_types_zeroExt(memory.bytes[GPR[instruction.rs] + machine_types_formOffset(instruction.immed)]);
+            vm->loads++;
+            check_address(vm, vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed), 1);
+            vm->GPR[instruction.rt] = machine_types_zeroExt(vm->memory.bytes[vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)]);
             break;
         case LW_O:
             // Load a word from memory and store it in the destination register.
-            GPR[instruction.rt] = memory.words[(GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD];
+            vm->loads++;
+            check_address(vm, vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed), BYTES_PER_WORD);
+            vm->GPR[instruction.rt] = vm->memory.words[(vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD];
             break;
         case SB_O:
             // Store a byte from the source register into memory.
-            memory.bytes[GPR[instruction.rs] + machine_types_formOffset(instruction.immed)] = GPR[instruction.rt];
+            vm->stores++;
+            check_address(vm, vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed), 1);
+            vm->memory.bytes[vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)] = vm->GPR[instruction.rt];
+            log_memory_write(vm, (vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD);
+            // keep the pre-decoded text (which fast mode's checks use) up to date
+            predecode_refresh(vm, (vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD);
             break;
         case SW_O:
             // Store a word from the source register into memory.
-            memory.words[(GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD] = GPR[instruction.rt];
+            vm->stores++;
+            check_address(vm, vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed), BYTES_PER_WORD);
+            vm->memory.words[(vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD] = vm->GPR[instruction.rt];
+            log_memory_write(vm, (vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD);
+            // keep the pre-decoded text (which fast mode's checks use) up to date
+            predecode_refresh(vm, (vm->GPR[instruction.rs] + machine_types_formOffset(instruction.immed)) / BYTES_PER_WORD);
             break;
     }
 }
 
 // Execute a jump-type instruction, updating the program counter (PC) accordingly.
-void execute_jump_type_instr(jump_instr_t instruction) 
+void execute_jump_type_instr(vm_state *vm, jump_instr_t instruction) 
 {
     switch (instruction.op) {
         case 2:
             // Execute an unconditional jump by updating the PC based on the address in the instruction.
-            PC = machine_types_formAddress(PC, instruction.addr);
+            vm->PC = machine_types_formAddress(vm->PC, instruction.addr);
             break;
         case 3:
             // Execute a jump and link (jal) operation, saving the return address in GPR[RA].
-            GPR[RA] = PC;
-            PC = machine_types_formAddress(PC, instruction.addr);
+            vm->GPR[RA] = vm->PC;
+            vm->PC = machine_types_formAddress(vm->PC, instruction.addr);
             break;
     }
 }
 
 // Function to check for errors based on invariants
-void error_check() 
+void error_check(vm_state *vm) 
 {
-    if (PC % BYTES_PER_WORD != 0) 
-        bail_with_error("Invariant broken: PC % BYTES_PER_WORD = 0");
+    if (vm->PC % BYTES_PER_WORD != 0) 
+        vm_fail(vm, "Invariant broken: PC % BYTES_PER_WORD = 0");
 
-    else if (GPR[GP] % BYTES_PER_WORD != 0) 
-        bail_with_error("Invariant broken: GPR[GP] % BYTES_PER_WORD = 0");
+    else if (vm->GPR[GP] % BYTES_PER_WORD != 0) 
+        vm_fail(vm, "Invariant broken: GPR[GP] % BYTES_PER_WORD = 0");
 
-    else if (GPR[SP] % BYTES_PER_WORD != 0) 
-        bail_with_error("Invariant broken: GPR[SP] % BYTES_PER_WORD = 0");
+    else if (vm->GPR[SP] % BYTES_PER_WORD != 0) 
+        vm_fail(vm, "Invariant broken: GPR[SP] % BYTES_PER_WORD = 0");
 
-    else if (GPR[FP] % BYTES_PER_WORD != 0) 
-        bail_with_error("Invariant broken: GPR[FP] % BYTES_PER_WORD = 0");
+    else if (vm->GPR[FP] % BYTES_PER_WORD != 0) 
+        vm_fail(vm, "Invariant broken: GPR[FP] % BYTES_PER_WORD = 0");
 
-    else if (0 > GPR[GP]) 
-        bail_with_error("Invariant broken: 0 < GPR[GP]");
+    else if (0 > vm->GPR[GP]) 
+        vm_fail(vm, "Invariant broken: 0 < GPR[GP]");
 
-    else if (GPR[GP] >= GPR[SP]) 
-        bail_with_error("Invariant broken: GPR[GP] < GPR[SP]");
+    else if (vm->GPR[GP] >= vm->GPR[SP]) 
+        vm_fail(vm, "Invariant broken: GPR[GP] < GPR[SP]");
 
-    else if (GPR[SP] > GPR[FP]) 
-        bail_with_error("Invariant broken: GPR[SP] <= GPR[FP]");
+    else if (vm->GPR[SP] > vm->GPR[FP]) 
+        vm_fail(vm, "Invariant broken: GPR[SP] <= GPR[FP]");
 
-    else if (GPR[FP] >= MEMORY_SIZE_IN_BYTES) 
-        bail_with_error("Invariant broken: GPR[FP] < MEMORY_SIZE_IN_BYTES");
+    else if (vm->GPR[FP] >= MEMORY_SIZE_IN_BYTES) 
+        vm_fail(vm, "Invariant broken: GPR[FP] < MEMORY_SIZE_IN_BYTES");
 
-    else if (0 > PC) 
-        bail_with_error("Invariant broken: 0 <= PC");
+    else if (0 > vm->PC) 
+        vm_fail(vm, "Invariant broken: 0 <= PC");
 
-    else if (PC >= MEMORY_SIZE_IN_BYTES) 
-        bail_with_error("Invariant broken: PC < MEMORY_SIZE_IN_BYTES");
+    else if (vm->PC >= MEMORY_SIZE_IN_BYTES) 
+        vm_fail(vm, "Invariant broken: PC < MEMORY_SIZE_IN_BYTES");
 
-    else if (GPR[0] != 0) 
-        bail_with_error("Invariant broken: GPR[0] = 0");
+    else if (vm->GPR[0] != 0) 
+        vm_fail(vm, "Invariant broken: GPR[0] = 0");
+
+    vm->invariants_checked = 1;
 
 }
 
 
 // Print the contents of program registers, including PC, HI, LO, and GPR.
-void print_registers(BOFHeader bof_header) 
+// Like the rest of the trace, this goes to stdout through the trace buffer.
+void print_registers(vm_state *vm) 
 {
     // Check if the HI and LO registers are non-zero, and print them along with PC.
-    if (HI != 0 || LO != 0)
-        printf("      PC: %d       HI: %d       LO: %d\n", PC, HI, LO);
-    else
-        printf("      PC: %d\n", PC); // Print PC
+    tracebuf_puts(&vm->tracebuf, "      PC: ");
+    tracebuf_put_int(&vm->tracebuf, vm->PC);
+    if (vm->HI != 0 || vm->LO != 0) {
+        tracebuf_puts(&vm->tracebuf, "       HI: ");
+        tracebuf_put_int(&vm->tracebuf, vm->HI);
+        tracebuf_puts(&vm->tracebuf, "       LO: ");
+        tracebuf_put_int(&vm->tracebuf, vm->LO);
+    }
+    tracebuf_putc(&vm->tracebuf, '\n');
 
     // Print the General Purpose Registers (GPR) with their values.
     for (int i = 0; i < 32; i++) 
     {
-        printf("GPR[%-3s]: %-4d    ", regname_get(i), GPR[i]);
+        tracebuf_puts(&vm->tracebuf, "GPR[");
+        tracebuf_puts_left(&vm->tracebuf, regname_get(i), 3);
+        tracebuf_puts(&vm->tracebuf, "]: ");
+        tracebuf_put_int_left(&vm->tracebuf, vm->GPR[i], 4);
+        tracebuf_puts(&vm->tracebuf, "    ");
         
         // Print a newline after every 6 registers for better formatting.
         if (i % 6 == 5)
-            newline(stdout);
+            tracebuf_putc(&vm->tracebuf, '\n');
     }
 
-    newline(stdout);
+    tracebuf_putc(&vm->tracebuf, '\n');
 
     // Print the data section.
-    print_data_section(bof_header);
+    print_data_section(vm);
 
     // Print the stack section.
-    print_stack(bof_header);
+    print_stack(vm);
 }
 
 
 // Helper function for print_registers
-void print_stack(BOFHeader bof_header) 
+void print_stack(vm_state *vm) 
 {
     int i, k = 1; // index of addresses in a line
-    printf("    "); // formatting
+    tracebuf_puts(&vm->tracebuf, "    "); // formatting
     // If no stack is used
-    if (GPR[SP] == GPR[FP])
+    if (vm->GPR[SP] == vm->GPR[FP])
     {
-        printf("%d: 0	...", GPR[SP]);
-        newline(stdout);
+        tracebuf_put_int(&vm->tracebuf, vm->GPR[SP]);
+        tracebuf_puts(&vm->tracebuf, ": 0\t...\n");
         return;
     }
     // print the stack
-    for (i = GPR[SP]; i < GPR[FP]; i += BYTES_PER_WORD)
+    for (i = vm->GPR[SP]; i < vm->GPR[FP]; i += BYTES_PER_WORD)
     {
         // If there are back to back 0s
-        if (memory.bytes[i-BYTES_PER_WORD] == 0 && memory.bytes[i] == 0 && i != GPR[SP])
+        if (vm->memory.bytes[i-BYTES_PER_WORD] == 0 && vm->memory.bytes[i] == 0 && i != vm->GPR[SP])
             continue;
         // If only the current value is 0
-        else if (memory.bytes[i] == 0)
+        else if (vm->memory.bytes[i] == 0)
         {
-            printf("%d: 0	...    ", i);
+            tracebuf_put_int(&vm->tracebuf, i);
+            tracebuf_puts(&vm->tracebuf, ": 0\t...    ");
 
             // Format 5 per line
             if (k == 5)
             {
-                printf("\n    ");
+                tracebuf_puts(&vm->tracebuf, "\n    ");
                 k = 1;
             } else k++;
             continue;
         }
 
-        printf("%d: %d	    ", i, memory.bytes[i]);
+        tracebuf_put_int(&vm->tracebuf, i);
+        tracebuf_puts(&vm->tracebuf, ": ");
+        tracebuf_put_int(&vm->tracebuf, vm->memory.bytes[i]);
+        tracebuf_puts(&vm->tracebuf, "\t    ");
 
         // Format 5 per line
         if (k == 5)
         {
-            printf("\n    ");
+            tracebuf_puts(&vm->tracebuf, "\n    ");
             k = 1;
         } else k++;
     }
 
-    if (memory.bytes[i-BYTES_PER_WORD] != 0)
-        printf("%d: 0	...", i);
+    if (vm->memory.bytes[i-BYTES_PER_WORD] != 0) {
+        tracebuf_put_int(&vm->tracebuf, i);
+        tracebuf_puts(&vm->tracebuf, ": 0\t...");
+    }
 
-    newline(stdout);
+    tracebuf_putc(&vm->tracebuf, '\n');
 }
@@ -1,61 +1,336 @@
 #ifndef _MACHINE_H
 #define _MACHINE_H
 
+#include <stdio.h>
+#include <setjmp.h>
 #include "bof.h"
 #include "instruction.h"
+#include "iolog.h"
 #include "machine_types.h"
+#include "predecode.h"
+#include "profile.h"
 #include "regname.h"
+#include "tracebuf.h"
 #include "utilities.h"
 
-// Size of memory 
+// Size of memory
 #define MEMORY_SIZE_IN_BYTES (65536 - BYTES_PER_WORD)
 #define MEMORY_SIZE_IN_WORDS (MEMORY_SIZE_IN_BYTES / BYTES_PER_WORD)
 
+// Size of the buffer for a VM's error message
+#define VM_ERROR_MESSAGE_SIZE 512
+
+// Size of the write log (see vm_state)
+#define WRITE_LOG_SIZE 16
+
+// Number of system call codes (the code field of a SYSCALL is 20 bits)
+#define VM_NUM_SYSCALL_CODES (1 << 20)
+
 // Create memory union so that we can access the memory by bytes or by words and store
 // instructions and data in memory
-static union mem_u {
+union mem_u {
     byte_type bytes[MEMORY_SIZE_IN_BYTES];
     word_type words[MEMORY_SIZE_IN_WORDS];
     bin_instr_t instrs[MEMORY_SIZE_IN_WORDS];
-} memory;
+};
+
+// The engines that can execute programs: the nested switches of
+// execute_instruction (the reference), the flat switch over pre-decoded
+// instructions, direct threading over pre-decoded instructions,
+// and native code compiled for hot basic blocks (see jit.h)
+typedef enum { engine_switch, engine_decoded, engine_threaded, engine_jit } engine_type;
+
+// The JIT's compiled code for a VM (defined in jit.c)
+struct jit_cache;
+
+// The memory that VMs forked from a VM share (defined in cow.c)
+struct cow_image;
+
+// What a VM does with its I/O log: nothing (it has none), write one
+// as it runs, or replay one instead of reading its input
+typedef enum { iolog_none, iolog_recording, iolog_replaying } iolog_mode;
+
+// The status of a VM: it can run more instructions, it ran EXIT,
+// PC left the text section, or it stopped with an error (see error_message)
+typedef enum { vm_running, vm_exited, vm_halted, vm_failed } vm_status;
+
+// The state of one VM: its memory and registers, the options it runs with,
+// where its input and output go, and what the engines keep while running.
+// Any number of VMs can exist at once; each is used through a vm_state *
+// (from vm_create) that every function in machine.c takes first.
+typedef struct {
+    // the machine
+    union mem_u memory;
+    word_type GPR[NUM_REGISTERS];
+    int PC, HI, LO;
+    int trace;
+    BOFHeader bof_header;
+
+    // options, which can be set between vm_create and running
+    engine_type engine;      // engine_decoded by default
+    int fast_mode;           // error_check only after instructions that can break an invariant
+    int delta_trace;         // the text trace only shows what changed
+    int exit_on_error;       // errors exit the process (as the vm program wants)
+    profile_t *profile;      // counts of what ran, if profiling (from profile_create)
+    // vm_run stops (with vm still running) once instruction_count reaches
+    // stop_count, or soon after with the threaded and JIT engines (0 for never)
+    unsigned long long stop_count;
+
+    // input, output, and traces
+    FILE *in;                // read by RCH
+    FILE *out;               // written by PSTR and PCH, and the text trace
+    tracebuf_t tracebuf;     // the text trace, buffered on its way to out
+    int bintrace_writing;    // is there a binary trace (in bintrace_file)?
+    BOFFILE bintrace_file;
+    iolog_mode iolog;        // is there an I/O log (in iolog_file)?
+    BOFFILE iolog_file;
+    // when replaying, the next event of the I/O log (iolog_replay_ended if none)
+    iolog_event iolog_next;
+    int iolog_replay_ended;
+
+    // how running went
+    vm_status status;
+
+    // counts of what has been executed, and for how long (see vm_write_summary)
+    unsigned long long instruction_count;  // instructions executed so far
+    unsigned long long loads;              // LBU and LW
+    unsigned long long stores;             // SB and SW
+    unsigned long long taken_branches;     // conditional branches that were taken
+    unsigned long long syscalls;           // system calls (with a handler)
+    double run_seconds;      // wall-clock time spent in finished calls of vm_run
+    double run_started;      // when the vm_run in progress started (0 if none)
+    char error_message[VM_ERROR_MESSAGE_SIZE];
+    jmp_buf on_error;        // where vm_fail goes unless exit_on_error
+
+    // pre-decoded copy of the text section, indexed by PC / BYTES_PER_WORD
+    predecoded_instr_t *predecoded_text;
+    int predecoded_length;
+    // label addresses of the threaded engine, indexed like predecoded_text
+    // (NULL until the threaded engine first runs)
+    void **threaded_code;
+    void *const *threaded_labels;
+    // the JIT's compiled blocks (NULL until the JIT engine first runs)
+    struct jit_cache *jit;
+    // has error_check run (and passed) at least once?
+    int invariants_checked;
+
+    // the image of memory that VMs forked from this one share
+    // (NULL unless vm_share made one)
+    struct cow_image *image;
+    // was this VM mapped by vm_fork, with memory shared with its base?
+    int mapped;
+
+    // The write log: word indexes of memory written since the last traced step,
+    // kept only for the binary and delta traces. When it overflows, or when
+    // instructions run untraced, all of memory has to be compared instead.
+    int write_log[WRITE_LOG_SIZE];
+    int write_log_length;
+    int write_log_overflowed;
+    // the registers and memory as of the last step written to the binary
+    // or delta trace
+    word_type traced_GPR[NUM_REGISTERS];
+    int traced_HI, traced_LO;
+    union mem_u traced_memory;
+    int delta_trace_started;
+    int delta_words_printed;
+} vm_state;
+
+// A system call's handler, which runs with PC already pointing to the next
+// instruction. System calls take their arguments from $a0 on and return
+// their results in $v0, and may fail with vm_fail.
+typedef void (*vm_syscall_handler)(vm_state *vm);
+
+// Requires: no VM has been loaded yet (VMs decode their system calls when
+//           loaded), and no VM is running (the table is shared by all VMs)
+// Add a system call to the VM: SYSCALL instructions with code (which must
+// not be one the VM already has) run handler, and are shown as mnemonic
+// in traces and listings (the string is not copied).
+// Exit with an error if code is out of range or in use.
+void vm_register_syscall(unsigned int code, const char *mnemonic, vm_syscall_handler handler);
+
+// Return a new VM, with all memory and registers zero, that reads from in
+// and writes to out, using the decoded engine and none of the other options.
+// Exit with an error if there is not enough memory for it.
+vm_state *vm_create(FILE *in, FILE *out);
+
+// Requires: nothing has been loaded into vm
+// Load the BOF file named filename into vm and set vm's registers to start it.
+// Return vm's status: vm_running, or vm_failed if filename cannot be read
+// as a BOF file or the program does not fit.
+vm_status vm_load(vm_state *vm, const char *filename);
+
+// Requires: nothing has been loaded into vm
+// Load the snapshot in the file named filename (see snapshot.h) into vm,
+// so that running vm resumes the program where the snapshot was taken.
+// Return vm's status: vm_running, or vm_failed if filename cannot be read
+// as a snapshot or the program does not fit.
+vm_status vm_resume(vm_state *vm, const char *filename);
+
+// Requires: vm is loaded
+// Write a snapshot of vm (see snapshot.h) to the file named filename
+// (exits with an error if the file cannot be written)
+void vm_write_snapshot(vm_state *vm, const char *filename);
+
+// Requires: vm is loaded, and is not run again while VMs forked from it exist
+// Make vm the base that vm_fork copies: its memory is put in an image that
+// the forked VMs share, each copying a page only when it first writes to it.
+// (If memory cannot be shared on this host, vm_fork copies all of it.)
+void vm_share(vm_state *base);
+
+// Requires: base was given to vm_share
+// Return a new VM, reading from in and writing to out, that starts where
+// base is: with its memory (shared copy-on-write), registers, trace flag,
+// options, and instruction count. Many threads can fork the same base at once.
+// Exit with an error if there is not enough memory for it.
+vm_state *vm_fork(const vm_state *base, FILE *in, FILE *out);
+
+// Requires: vm is loaded
+// Execute the instruction at PC (tracing it if the trace flag is set)
+// and return vm's status afterwards. Does nothing unless vm is running.
+vm_status vm_step(vm_state *vm);
+
+// Requires: vm is loaded
+// Run vm until it exits, PC leaves the text section, or there is an error,
+// or until it reaches vm->stop_count instructions (if that is not 0),
+// then write out any buffered output and return vm's status
+// (vm_running if it stopped at stop_count, in which case it can run again).
+vm_status vm_run(vm_state *vm);
+
+// Write out vm's buffered output (what the program printed and its trace)
+// to its output file
+void vm_flush_output(vm_state *vm);
+
+// Return the wall-clock time vm has spent running (in vm_run), in seconds
+double vm_run_seconds(vm_state *vm);
+
+// Write a summary of vm's run (its status and counts, the time it ran,
+// and the instructions executed per second) to out, as a JSON object
+// on one line. program is the name of the BOF file vm runs.
+void vm_write_summary(vm_state *vm, const char *program, FILE *out);
+
+// Requires: vm is loaded
+// Record the input vm reads and the output it writes, with the instruction
+// count of each system call, in a new I/O log file named filename
+// (exits with an error if the file cannot be opened)
+void vm_record_io(vm_state *vm, const char *filename);
+
+// Requires: vm is loaded
+// Replay the I/O log in the file named filename (made by vm_record_io)
+// as vm runs: what RCH reads comes from the log instead of vm's input,
+// what PCH and PSTR return comes from the log (they still write to vm's
+// output), and vm fails if the program's system calls stop matching
+// the log. Logged events from before vm's current instruction count
+// (e.g., when vm was resumed from a snapshot) are skipped.
+// Return vm's status: vm_failed if the file cannot be read as an I/O log.
+vm_status vm_replay_io(vm_state *vm, const char *filename);
+
+// Requires: vm is loaded
+// Write vm's trace to a new binary trace file named filename
+// instead of as text (exits with an error if the file cannot be opened)
+void vm_write_binary_trace(vm_state *vm, const char *filename);
+
+// Flush vm's output, close its binary trace (if any), and free vm
+// (the in and out files given to vm_create or vm_fork are left open,
+// and VMs forked from vm can still be used)
+void vm_destroy(vm_state *vm);
+
+// Stop vm with an error: format the message (like printf) into vm's
+// error_message and either exit with it (if vm->exit_on_error)
+// or return to the vm_load, vm_step, or vm_run that was running
+// with status vm_failed. Does not return.
+void vm_fail(vm_state *vm, const char *fmt, ...);
+
+// Stop vm with an error for an access to the size bytes at byte address
+// addr, which are not all in memory. Does not return.
+// (Also called by the JIT's compiled loads and stores.)
+void vm_memory_fault(vm_state *vm, word_type addr, word_type size);
+
+// Stop vm with an error for dividing dividend by divisor, which is 0,
+// or -1 with dividend the most negative word (an overflow).
+// Does not return. (Also called by the JIT's compiled divisions.)
+void vm_division_fault(vm_state *vm, word_type dividend, word_type divisor);
 
 // Function to load data from BOF file into memory
-void load_data_section(BOFHeader bof_header, BOFFILE bof_file);
+// (return whether the whole data section could be read)
+int load_data_section(vm_state *vm, BOFFILE bof_file);
 
 // Function to load instructions from BOF file into memory
-void load_instruction_section(BOFHeader bof_header, BOFFILE bof_file);
+// (return whether the whole text section could be read)
+int load_instruction_section(vm_state *vm, BOFFILE bof_file);
 
-// Prints the instructions in MIPS architecture to stdout
-void print_instruction_section(BOFHeader bof_header);
+// Copy the text and data sections of the mapped BOF file bm into memory
+void load_mapped_sections(vm_state *vm, BOFMAP bm);
 
-// Prints the data section, formatted, to stdout
-void print_data_section(BOFHeader bof_header);
+// Decode the text section (and the word after it) once, before execution
+void predecode_text_section(vm_state *vm);
 
-// Initialize registers, program counter, and trace flag using BOFHeader data.
-void set_registers(BOFHeader bof_header);
+// Re-decode memory.instrs[index] if it is in the pre-decoded text,
+// to be called after a store so that self-modifying code keeps working.
+void predecode_refresh(vm_state *vm, int index);
+
+// Prints the instructions in MIPS architecture to vm's output
+void print_instruction_section(vm_state *vm);
+
+// Prints the data section, formatted, to vm's output
+void print_data_section(vm_state *vm);
+
+// Initialize registers, program counter, and trace flag using vm's BOFHeader.
+void set_registers(vm_state *vm);
+
+// Execute the instruction at PC with the chosen engine, tracing it if needed.
+void execute_step(vm_state *vm);
+
+// Run pre-decoded instructions with direct threading until PC leaves
+// the text section, tracing is turned on, the program exits,
+// or vm->stop_count is reached (checked at jumps and branches).
+void run_threaded(vm_state *vm);
+
+// Run compiled blocks where the JIT has them, and other instructions
+// one at a time, until PC leaves the text section, tracing is turned on,
+// the program exits, or vm->stop_count is reached (checked between blocks).
+void run_jit(vm_state *vm);
 
 // Execute an instruction based on its type, handling various instruction categories.
-void execute_instruction(bin_instr_t instruction);
+void execute_instruction(vm_state *vm, bin_instr_t instruction);
+
+// Execute a pre-decoded instruction, with PC already pointing to the next one.
+void execute_predecoded_instr(vm_state *vm, const predecoded_instr_t *instruction);
+
+// Execute the fused pair of pre-decoded instructions that starts with
+// instruction, with PC already pointing to the second one.
+void execute_fused_instrs(vm_state *vm, const predecoded_instr_t *instruction);
 
 // Execute a register-type instruction, performing arithmetic and logical operations.
-void execute_reg_type_instr(reg_instr_t instruction);
+void execute_reg_type_instr(vm_state *vm, reg_instr_t instruction);
 
-// Execute a syscall-type instruction, handling various system call operations.
-void execute_syscall_type_instr(syscall_instr_t instruction);
+// Execute a syscall-type instruction through the system call table
+// (a code without a handler does nothing).
+void execute_syscall_type_instr(vm_state *vm, syscall_instr_t instruction);
 
 // Execute an immediate-type instruction, performing operations based on the instruction type.
-void execute_immed_type_instr(immed_instr_t instruction);
+void execute_immed_type_instr(vm_state *vm, immed_instr_t instruction);
 
 // Execute a jump-type instruction, updating the program counter (PC) accordingly.
-void execute_jump_type_instr(jump_instr_t instruction);
+void execute_jump_type_instr(vm_state *vm, jump_instr_t instruction);
 
 // Function to check for errors based on invariants
-void error_check();
+void error_check(vm_state *vm);
+
+// Print the trace of instruction, which is about to be executed at PC
+void print_trace_step(vm_state *vm, bin_instr_t instruction);
+
+// Print the trace of instruction, which is about to be executed at PC,
+// showing only what changed since the previous traced step
+void print_delta_trace_step(vm_state *vm, bin_instr_t instruction);
+
+// Write PC, instruction, and the registers and memory words changed
+// since the last step written to the binary trace
+void write_binary_trace_step(vm_state *vm, bin_instr_t instruction);
 
 // Print the contents of program registers, including PC, HI, LO, and GPR.
-void print_registers(BOFHeader bof_header);
+void print_registers(vm_state *vm);
 
 // Helper function for print_registers
-void print_stack(BOFHeader bof_header);
+void print_stack(vm_state *vm);
 
 #endif
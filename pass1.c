@@ -42,11 +42,14 @@ void pass1LabelOpt(label_opt_t lopt, address_type count)
     if (lopt.name != NULL) {
 	id_attrs attrs;
 	if (symtab_defined(lopt.name)) {
-	    bail_with_error("Duplicate declaration of label \"%s\"",
+	    bail_with_error("%s:%u: Duplicate declaration of label \"%s\"",
+			    file_location_filename(lopt.file_loc),
+			    file_location_line(lopt.file_loc),
 			    lopt.name);
 	}
 	attrs.name = lopt.name;
 	attrs.kind = id_label;
+	attrs.file_loc = lopt.file_loc;
 	attrs.addr = count;
 	symtab_insert(attrs);
     }
@@ -80,12 +83,15 @@ void pass1StaticDecl(static_decl_t dcl, address_type offset)
 void pass1Ident(ident_t id, address_type offset)
 {
     if (symtab_defined(id.name)) {
-	bail_with_error("Duplicate declaration of data name \"%s\"",
+	bail_with_error("%s:%u: Duplicate declaration of data name \"%s\"",
+			file_location_filename(id.file_loc),
+			file_location_line(id.file_loc),
 			id.name);
     }
     id_attrs attrs;
     attrs.name = id.name;
     attrs.kind = id_data;
+    attrs.file_loc = id.file_loc;
     attrs.addr = offset;
     symtab_insert(attrs);
 }
@@ -0,0 +1,176 @@
+#include "instruction.h"
+#include "machine.h"
+#include "machine_types.h"
+#include "regname.h"
+#include "predecode.h"
+
+// Return the handler for the register-type instruction ri
+static predecode_handler predecode_reg_handler(reg_instr_t ri) {
+    switch (ri.func) {
+        case ADD_F:  return pd_add;
+        case SUB_F:  return pd_sub;
+        case MUL_F:  return pd_mul;
+        case DIV_F:  return pd_div;
+        case MFHI_F: return pd_mfhi;
+        case MFLO_F: return pd_mflo;
+        case AND_F:  return pd_and;
+        case BOR_F:  return pd_bor;
+        case XOR_F:  return pd_xor;
+        case NOR_F:  return pd_nor;
+        case SLL_F:  return pd_sll;
+        case SRL_F:  return pd_srl;
+        case JR_F:   return pd_jr;
+        default:     return pd_nop;
+    }
+}
+
+// Return the handler for the system call instruction si
+static predecode_handler predecode_syscall_handler(syscall_instr_t si) {
+    switch (si.code) {
+        case exit_sc:          return pd_exit;
+        case print_str_sc:     return pd_pstr;
+        case print_char_sc:    return pd_pch;
+        case read_char_sc:     return pd_rch;
+        case start_tracing_sc: return pd_stra;
+        case stop_tracing_sc:  return pd_notr;
+        default:
+            return instruction_syscall_known(si.code) ? pd_syscall : pd_nop;
+    }
+}
+
+// Return the handler for the immediate-type instruction ii
+static predecode_handler predecode_immed_handler(immed_instr_t ii) {
+    switch (ii.op) {
+        case ADDI_O: return pd_addi;
+        case ANDI_O: return pd_andi;
+        case BORI_O: return pd_bori;
+        case XORI_O: return pd_xori;
+        case BEQ_O:  return pd_beq;
+        case BGEZ_O: return pd_bgez;
+        case BGTZ_O: return pd_bgtz;
+        case BLEZ_O: return pd_blez;
+        case BLTZ_O: return pd_bltz;
+        case BNE_O:  return pd_bne;
+        case LBU_O:  return pd_lbu;
+        case LW_O:   return pd_lw;
+        case SB_O:   return pd_sb;
+        case SW_O:   return pd_sw;
+        default:     return pd_illegal;
+    }
+}
+
+// Is r a register that error_check looks at?
+static int predecode_invariant_reg(unsigned char r) {
+    return r == 0 || r == GP || r == SP || r == FP;
+}
+
+// Can executing the pre-decoded instruction pi, at byte address addr,
+// break one of the invariants checked by error_check?
+static int predecode_check_invariants(predecoded_instr_t pi, address_type addr) {
+    // the PC moving to the next word can put it out of memory,
+    // whatever the instruction is
+    if (addr + BYTES_PER_WORD >= MEMORY_SIZE_IN_BYTES)
+        return 1;
+    switch (pi.handler) {
+        // these change the PC
+        case pd_jr: case pd_jmp: case pd_jal:
+        case pd_beq: case pd_bgez: case pd_bgtz:
+        case pd_blez: case pd_bltz: case pd_bne:
+            return 1;
+        // a system call's handler may change any register
+        case pd_syscall:
+            return 1;
+        // these write rd
+        case pd_add: case pd_sub: case pd_mfhi: case pd_mflo:
+        case pd_and: case pd_bor: case pd_xor: case pd_nor:
+        case pd_sll: case pd_srl:
+            return predecode_invariant_reg(pi.rd);
+        // these write rt
+        case pd_addi: case pd_andi: case pd_bori: case pd_xori:
+        case pd_lbu: case pd_lw:
+            return predecode_invariant_reg(pi.rt);
+        // these write only HI, LO, $v0, or memory
+        default:
+            return 0;
+    }
+}
+
+// Return the pre-decoded form of instr, which is located at byte address addr.
+// Immediates are extended exactly as the executors in machine.c extend them,
+// and targets are computed from the PC value the executors would see
+// (i.e., addr already advanced by one word).
+predecoded_instr_t predecode_instr(bin_instr_t instr, address_type addr) {
+    predecoded_instr_t ret = { pd_illegal, 0, 0, 0, 1, pf_none, 0 };
+    address_type next_pc = addr + BYTES_PER_WORD;
+
+    switch (instruction_type(instr)) {
+        case reg_instr_type:
+            ret.handler = predecode_reg_handler(instr.reg);
+            ret.rs = instr.reg.rs;
+            ret.rt = instr.reg.rt;
+            ret.rd = instr.reg.rd;
+            ret.arg = instr.reg.shift;
+            break;
+        case syscall_instr_type:
+            ret.handler = predecode_syscall_handler(instr.syscall);
+            ret.arg = instr.syscall.code;
+            break;
+        case immed_instr_type:
+            ret.handler = predecode_immed_handler(instr.immed);
+            ret.rs = instr.immed.rs;
+            ret.rt = instr.immed.rt;
+            switch (instr.immed.op) {
+                case ADDI_O:
+                    ret.arg = machine_types_sgnExt(instr.immed.immed);
+                    break;
+                case ANDI_O: case BORI_O: case XORI_O:
+                    ret.arg = machine_types_zeroExt(instr.immed.immed);
+                    break;
+                case BEQ_O: case BGEZ_O: case BGTZ_O:
+                case BLEZ_O: case BLTZ_O: case BNE_O:
+                    ret.arg = next_pc + machine_types_formOffset(instr.immed.immed);
+                    break;
+                default:
+                    // loads and stores
+                    ret.arg = machine_types_formOffset(instr.immed.immed);
+                    break;
+            }
+            break;
+        case jump_instr_type:
+            ret.handler = instr.jump.op == JAL_O ? pd_jal : pd_jmp;
+            ret.arg = machine_types_formAddress(next_pc, instr.jump.addr);
+            break;
+        default:
+            ret.handler = pd_illegal;
+            break;
+    }
+    ret.check_invariants = predecode_check_invariants(ret, addr);
+    return ret;
+}
+
+// Return the fusion of the pre-decoded instructions first and second,
+// which follows it, or pf_none if they are not a pair that is fused
+static predecode_fusion predecode_fusion_of(predecoded_instr_t first,
+                                            predecoded_instr_t second) {
+    if (first.check_invariants)
+        return pf_none;
+    if (first.handler == pd_addi && second.handler == pd_bne)
+        return pf_addi_bne;
+    if (first.handler == pd_mul && second.handler == pd_mflo)
+        return pf_mul_mflo;
+    if (first.handler == pd_lw && second.handler == pd_add)
+        return pf_lw_add;
+    // $a0 is register 4, the character PCH prints
+    if (first.handler == pd_add && first.rd == 4 && second.handler == pd_pch)
+        return pf_add_pch;
+    return pf_none;
+}
+
+// Set the fused field of text[index], the pre-decoded instruction
+// followed by text[index + 1] (if index + 1 < length)
+void predecode_fuse(predecoded_instr_t *text, int length, int index) {
+    if (index + 1 < length)
+        text[index].fused = predecode_fusion_of(text[index], text[index + 1]);
+    else
+        text[index].fused = pf_none;
+}
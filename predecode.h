@@ -0,0 +1,65 @@
+#ifndef _PREDECODE_H
+#define _PREDECODE_H
+
+#include "instruction.h"
+#include "machine_types.h"
+
+// Handlers for pre-decoded instructions, one per operation the VM executes
+typedef enum {
+    pd_add, pd_sub, pd_mul, pd_div, pd_mfhi, pd_mflo,
+    pd_and, pd_bor, pd_xor, pd_nor, pd_sll, pd_srl, pd_jr,
+    pd_exit, pd_pstr, pd_pch, pd_rch, pd_stra, pd_notr,
+    pd_addi, pd_andi, pd_bori, pd_xori,
+    pd_beq, pd_bgez, pd_bgtz, pd_blez, pd_bltz, pd_bne,
+    pd_lbu, pd_lw, pd_sb, pd_sw,
+    pd_jmp, pd_jal,
+    pd_syscall,  // any other system call with a mnemonic, run through the VM's table
+    pd_nop,      // unknown function or system call code, which does nothing
+    pd_illegal,  // not a valid instruction type, executing it is an error
+    pd_num_handlers
+} predecode_handler;
+
+// Pairs of instructions that can be executed together by one handler
+// (a superinstruction), saving a dispatch, when the first is followed
+// by the second in the text section (see predecode_fuse)
+typedef enum {
+    pf_none,      // not the first instruction of a fused pair
+    pf_addi_bne,  // ADDI then BNE, as in counting loops
+    pf_mul_mflo,  // MUL then MFLO
+    pf_lw_add,    // LW then ADD
+    pf_add_pch,   // ADD into $a0 then PCH, printing a character
+    pf_num_fusions
+} predecode_fusion;
+
+// An instruction decoded once at load time, so the VM's main loop
+// does not have to look at the bitfields of the binary instruction again
+typedef struct {
+    unsigned char handler;  // the predecode_handler that executes it
+    unsigned char rs;
+    unsigned char rt;
+    unsigned char rd;
+    // can executing it break an invariant checked by error_check?
+    // (true for changes to PC other than by one word, and writes to $0,
+    // $gp, $sp, or $fp)
+    unsigned char check_invariants;
+    // the predecode_fusion of this instruction and the next one
+    // (the next one is still decoded on its own, as it can be jumped to)
+    unsigned char fused;
+    // sign- or zero-extended immediate (ADDI, ANDI, BORI, XORI),
+    // shift amount (SLL, SRL), byte offset (LBU, LW, SB, SW),
+    // target byte address (branches, JMP, JAL), or system call code (pd_syscall)
+    word_type arg;
+} predecoded_instr_t;
+
+// Return the pre-decoded form of instr, which is located at byte address addr
+extern predecoded_instr_t predecode_instr(bin_instr_t instr, address_type addr);
+
+// Requires: 0 <= index < length
+// Set the fused field of text[index], the pre-decoded instruction that is
+// followed by text[index + 1] (if index + 1 < length), in the pre-decoded
+// text section text of length words. Pairs are only fused when the first
+// instruction cannot break an invariant, so that checking the invariants
+// after the pair is the same as checking after each instruction.
+extern void predecode_fuse(predecoded_instr_t *text, int length, int index);
+
+#endif
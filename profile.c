@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "instruction.h"
+#include "machine_types.h"
+#include "predecode.h"
+#include "utilities.h"
+#include "profile.h"
+
+// Return a new profile, with all counts zero, for a text section
+// (with the word after it) of length words
+profile_t *profile_create(int length) {
+    profile_t *p = (profile_t *) calloc(1, sizeof(profile_t));
+
+    if (p == NULL) {
+        bail_with_error("Cannot allocate space for the profile");
+    }
+    p->length = length;
+    p->pc_counts = (unsigned long long *) calloc(length, sizeof(unsigned long long));
+    if (p->pc_counts == NULL) {
+        bail_with_error("Cannot allocate space for the profile");
+    }
+    return p;
+}
+
+// Count an execution of instr, the word at index
+void profile_count(profile_t *p, int index, bin_instr_t instr) {
+    p->pc_counts[index]++;
+    p->total++;
+    p->op_counts[instr.reg.op]++;
+    if (instr.reg.op == REG_O)
+        p->func_counts[instr.reg.func]++;
+}
+
+// Count an execution of a branch with opcode op, which was taken or not
+void profile_branch(profile_t *p, int op, int taken) {
+    if (taken)
+        p->taken[op]++;
+    else
+        p->not_taken[op]++;
+}
+
+// Return the mnemonic of instr, or NULL if it is not an instruction
+// the VM executes (instruction_mnemonic would exit with an error)
+static const char *profile_mnemonic(bin_instr_t instr) {
+    int handler = predecode_instr(instr, 0).handler;
+
+    if (handler == pd_nop || handler == pd_illegal)
+        return NULL;
+    return instruction_mnemonic(instr);
+}
+
+// Return count as a percentage of total
+static double profile_percent(unsigned long long count, unsigned long long total) {
+    return total == 0 ? 0.0 : 100.0 * count / total;
+}
+
+// Print the PROFILE_HOTSPOTS most executed addresses, most executed first
+static void profile_report_hotspots(const profile_t *p, const bin_instr_t *text, FILE *out) {
+    int hot[PROFILE_HOTSPOTS];
+    int num_hot = 0;
+    int i, j;
+
+    // keep the most executed indexes seen so far in hot, sorted
+    // (with ties in address order), by insertion
+    for (i = 0; i < p->length; i++) {
+        if (p->pc_counts[i] == 0)
+            continue;
+        if (num_hot == PROFILE_HOTSPOTS) {
+            if (p->pc_counts[i] <= p->pc_counts[hot[num_hot - 1]])
+                continue;
+            num_hot--;
+        }
+        for (j = num_hot; j > 0 && p->pc_counts[hot[j - 1]] < p->pc_counts[i]; j--)
+            hot[j] = hot[j - 1];
+        hot[j] = i;
+        num_hot++;
+    }
+
+    fprintf(out, "Hotspots (the %d most executed addresses):\n", PROFILE_HOTSPOTS);
+    fprintf(out, "%14s %7s %6s  %s\n", "Count", "%", "Addr", "Instruction");
+    for (j = 0; j < num_hot; j++) {
+        i = hot[j];
+        fprintf(out, "%14llu %6.2f%% %6d  ", p->pc_counts[i],
+                profile_percent(p->pc_counts[i], p->total), i * BYTES_PER_WORD);
+        if (profile_mnemonic(text[i]) != NULL)
+            fprintf(out, "%s\n", instruction_assembly_form(text[i]));
+        else
+            fprintf(out, "(no-op)\n");
+    }
+}
+
+// Print the counts by opcode, and for opcode 0 by function code
+static void profile_report_codes(const profile_t *p, FILE *out) {
+    bin_instr_t instr = {0};
+    const char *name;
+    int code;
+
+    fprintf(out, "Executions by opcode and function code:\n");
+    fprintf(out, "%14s %7s %4s %4s  %s\n", "Count", "%", "Op", "Func", "Mnemonic");
+    for (code = 0; code < PROFILE_NUM_CODES; code++) {
+        if (code == REG_O || p->op_counts[code] == 0)
+            continue;
+        instr.immed.op = code;
+        name = profile_mnemonic(instr);
+        fprintf(out, "%14llu %6.2f%% %4d %4s  %s\n", p->op_counts[code],
+                profile_percent(p->op_counts[code], p->total), code, "",
+                name != NULL ? name : "?");
+    }
+    for (code = 0; code < PROFILE_NUM_CODES; code++) {
+        if (p->func_counts[code] == 0)
+            continue;
+        instr.reg.op = REG_O;
+        instr.reg.func = code;
+        // system calls are named by their codes, which are not counted
+        name = code == SYSCALL_F ? "SYSCALL" : profile_mnemonic(instr);
+        fprintf(out, "%14llu %6.2f%% %4d %4d  %s\n", p->func_counts[code],
+                profile_percent(p->func_counts[code], p->total), REG_O, code,
+                name != NULL ? name : "(no-op)");
+    }
+}
+
+// Print how often each branch opcode was taken and not taken
+static void profile_report_branches(const profile_t *p, FILE *out) {
+    bin_instr_t instr = {0};
+    unsigned long long executed;
+    int op;
+
+    fprintf(out, "Branches:\n");
+    fprintf(out, "%-6s %14s %14s %7s\n", "Branch", "Taken", "Not taken", "Taken%");
+    for (op = 0; op < PROFILE_NUM_CODES; op++) {
+        executed = p->taken[op] + p->not_taken[op];
+        if (executed == 0)
+            continue;
+        instr.immed.op = op;
+        fprintf(out, "%-6s %14llu %14llu %6.2f%%\n", instruction_mnemonic(instr),
+                p->taken[op], p->not_taken[op], profile_percent(p->taken[op], executed));
+    }
+}
+
+// Print p's report on out
+void profile_report(const profile_t *p, const bin_instr_t *text, FILE *out) {
+    fprintf(out, "Profile: %llu instructions executed\n", p->total);
+    profile_report_hotspots(p, text, out);
+    profile_report_codes(p, out);
+    profile_report_branches(p, out);
+    fflush(out);
+}
+
+// Free p
+void profile_destroy(profile_t *p) {
+    free(p->pc_counts);
+    free(p);
+}
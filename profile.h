@@ -0,0 +1,46 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdio.h>
+#include "instruction.h"
+
+// Number of opcodes (and of function codes), which are 6 bits
+#define PROFILE_NUM_CODES 64
+
+// Number of addresses listed in a profile's hotspot report
+#define PROFILE_HOTSPOTS 20
+
+// Counts of what a program executed, for the VM's -prof option
+typedef struct {
+    int length;                      // words counted in pc_counts
+    unsigned long long *pc_counts;   // executions of the word at each index
+    unsigned long long total;        // instructions executed
+    unsigned long long op_counts[PROFILE_NUM_CODES];
+    // executions of register-type instructions (opcode 0) by function code
+    unsigned long long func_counts[PROFILE_NUM_CODES];
+    // outcomes of the branch instructions, by opcode
+    unsigned long long taken[PROFILE_NUM_CODES];
+    unsigned long long not_taken[PROFILE_NUM_CODES];
+} profile_t;
+
+// Return a new profile, with all counts zero, for a program whose
+// text section (with the word after it) has length words.
+// Exit with an error if there is not enough memory for it.
+extern profile_t *profile_create(int length);
+
+// Requires: 0 <= index < p->length
+// Count an execution of instr, the word at index
+extern void profile_count(profile_t *p, int index, bin_instr_t instr);
+
+// Count an execution of a branch with opcode op, which was taken or not
+extern void profile_branch(profile_t *p, int op, int taken);
+
+// Print p's report on out: the most executed addresses, with text[index]
+// as the instruction at each, then the counts by opcode and function code,
+// then the branch outcomes
+extern void profile_report(const profile_t *p, const bin_instr_t *text, FILE *out);
+
+// Free p
+extern void profile_destroy(profile_t *p);
+
+#endif
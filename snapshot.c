@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bof.h"
+#include "machine_types.h"
+#include "utilities.h"
+#include "snapshot.h"
+
+// Size of the stdio buffer used when writing a snapshot
+#define SNAPSHOT_BUFFER_SIZE (64 * 1024)
+
+// Write the runs of memory words of vm that are not zero, then the end marker
+static void snapshot_write_memory(BOFFILE bf, const vm_state *vm) {
+    const word_type *words = vm->memory.words;
+    int start, end;
+
+    start = 0;
+    while (start < MEMORY_SIZE_IN_WORDS) {
+        if (words[start] == 0) {
+            start++;
+            continue;
+        }
+        // a run ends at the end of memory or at two zero words in a row
+        // (a single zero costs less inside a run than starting a new one)
+        end = start + 1;
+        while (end < MEMORY_SIZE_IN_WORDS
+               && (words[end] != 0
+                   || (end + 1 < MEMORY_SIZE_IN_WORDS && words[end + 1] != 0)))
+            end++;
+        bof_write_word(bf, start);
+        bof_write_word(bf, end - start);
+        bof_write_words(bf, &words[start], end - start);
+        start = end;
+    }
+    bof_write_word(bf, 0);
+    bof_write_word(bf, 0);
+}
+
+// Write a snapshot of vm to a new file named filename, replacing it
+// only once the snapshot is complete.
+// Exit with an error if the file cannot be written.
+void snapshot_write(const vm_state *vm, const char *filename) {
+    char magic[MAGIC_BUFFER_SIZE] = SNAPSHOT_MAGIC;
+    char *temp_name = malloc(strlen(filename) + 5);
+    BOFFILE bf;
+
+    if (temp_name == NULL) {
+        bail_with_error("Cannot allocate space for a snapshot file name");
+    }
+    sprintf(temp_name, "%s.tmp", filename);
+    bf = bof_write_open(temp_name);
+    setvbuf(bf.fileptr, NULL, _IOFBF, SNAPSHOT_BUFFER_SIZE);
+
+    bof_write_bytes(bf, MAGIC_BUFFER_SIZE, magic);
+    bof_write_header(bf, vm->bof_header);
+    bof_write_word(bf, vm->PC);
+    bof_write_word(bf, vm->HI);
+    bof_write_word(bf, vm->LO);
+    bof_write_word(bf, vm->trace);
+    bof_write_word(bf, (word_type) (vm->instruction_count & 0xFFFFFFFF));
+    bof_write_word(bf, (word_type) (vm->instruction_count >> 32));
+    bof_write_words(bf, vm->GPR, NUM_REGISTERS);
+    snapshot_write_memory(bf, vm);
+    bof_close(bf);
+
+    if (rename(temp_name, filename) != 0) {
+        bail_with_error("Cannot rename %s to %s", temp_name, filename);
+    }
+    free(temp_name);
+}
+
+// Read n words from bf into dst; return 1 if all n can be read, else 0
+static int snapshot_read_words(BOFFILE bf, word_type *dst, size_t n) {
+    return n == 0 || fread(dst, BYTES_PER_WORD, n, bf.fileptr) == n;
+}
+
+// Read the runs of memory words in bf into vm's memory, up to the end marker.
+// Return NULL if that works, else a message (with a %s for the file name)
+// that says what is wrong.
+static const char *snapshot_read_memory(BOFFILE bf, vm_state *vm) {
+    word_type run[2];
+
+    for (;;) {
+        if (!snapshot_read_words(bf, run, 2))
+            return "Snapshot %s ends before its end marker";
+        if (run[1] == 0)
+            return NULL;
+        if (run[0] < 0 || run[1] < 0 || run[1] > MEMORY_SIZE_IN_WORDS - run[0])
+            return "Snapshot %s has words outside of memory";
+        if (!snapshot_read_words(bf, &vm->memory.words[run[0]], run[1]))
+            return "Snapshot %s ends before its end marker";
+    }
+}
+
+// Read the snapshot in the file named filename into vm's memory,
+// registers, BOFHeader, trace flag, and instruction count.
+// Return 1 if that works.
+// Return 0 if the file cannot be opened or is not a complete snapshot,
+// putting a message that says so in error (of size error_size).
+int snapshot_read(vm_state *vm, const char *filename,
+                  char *error, size_t error_size) {
+    char magic[MAGIC_BUFFER_SIZE];
+    word_type words[6];
+    const char *problem = NULL;
+    BOFFILE bf;
+
+    bf.filename = filename;
+    bf.fileptr = fopen(filename, "rb");
+    if (bf.fileptr == NULL) {
+        snprintf(error, error_size, "Error opening file for reading: %s", filename);
+        return 0;
+    }
+    if (bof_read_bytes(bf, MAGIC_BUFFER_SIZE, magic) != 1
+        || strncmp(magic, SNAPSHOT_MAGIC, MAGIC_BUFFER_SIZE) != 0) {
+        problem = "File %s is not a snapshot, bad magic number!";
+    } else if (bof_read_bytes(bf, sizeof(BOFHeader), &vm->bof_header) != 1
+               || !snapshot_read_words(bf, words, 6)
+               || !snapshot_read_words(bf, vm->GPR, NUM_REGISTERS)) {
+        problem = "Snapshot %s ends before its memory";
+    } else {
+        vm->PC = words[0];
+        vm->HI = words[1];
+        vm->LO = words[2];
+        vm->trace = words[3];
+        vm->instruction_count = (unsigned) words[4]
+            | ((unsigned long long) (unsigned) words[5] << 32);
+        problem = snapshot_read_memory(bf, vm);
+    }
+    fclose(bf.fileptr);
+    if (problem != NULL) {
+        snprintf(error, error_size, problem, filename);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,34 @@
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include "machine.h"
+
+// A snapshot holds everything needed to resume a VM where it was:
+// its memory and registers, and how far it had run.
+// It starts with the magic "SNP" and the BOFHeader of the program,
+// then PC, HI, LO, the trace flag, the instruction count (as two words,
+// low word first), and the general purpose registers.
+// Memory follows as runs of words that are not all zero, each stored
+// as the index of its first word, its length in words, and its words.
+// A run of length 0 ends the snapshot.
+// All numbers are stored in the machine's byte order, as in BOF files.
+
+#define SNAPSHOT_MAGIC "SNP"
+
+// Write a snapshot of vm to a new file named filename, replacing it
+// only once the snapshot is complete (so an earlier snapshot there
+// survives if this program stops while writing).
+// Exit with an error if the file cannot be written.
+extern void snapshot_write(const vm_state *vm, const char *filename);
+
+// Requires: nothing has been loaded into vm
+// Read the snapshot in the file named filename into vm's memory,
+// registers, BOFHeader, trace flag, and instruction count.
+// Return 1 if that works.
+// Return 0 if the file cannot be opened or is not a complete snapshot,
+// putting a message that says so in error (of size error_size).
+// (This does not exit, so a program can go on after a bad file.)
+extern int snapshot_read(vm_state *vm, const char *filename,
+                         char *error, size_t error_size);
+
+#endif
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "arena.h"
+#include "assemble.h"
+#include "pass1.h"
+#include "symtab.h"
+#include "id_attrs.h"
+#include "instruction.h"
+#include "utilities.h"
+
+// The number of fixups the array of them starts with
+#define STREAM_INITIAL_FIXUPS 1024
+
+// a jump assembled before its label was defined
+typedef struct {
+    unsigned int index;  // of the jump's word in the text section
+    unsigned short op;   // the jump's opcode
+    lora_t target;
+} stream_fixup;
+
+static bool streaming = false;
+static BOFFILE out;
+static unsigned int text_words = 0;   // written to out so far
+static unsigned int data_words = 0;   // written to out so far
+static address_type data_offset = 0;  // of the next static declaration
+static stream_fixup *fixups = NULL;
+static unsigned int num_fixups = 0;
+static unsigned int fixups_capacity = 0;
+// where parse_arena is reset to after each statement
+static arena_mark_t statement_start;
+
+// Close and remove the BOF file being written, which is incomplete
+// (called by bail_with_error, while streaming, before it exits)
+void stream_abandon()
+{
+    bail_with_error_set_flush(NULL);
+    fclose(out.fileptr);
+    remove(out.filename);
+    streaming = false;
+}
+
+// Start single-pass assembly of a program into bf (before parsing it),
+// writing a placeholder header to bf
+void stream_start(BOFFILE bf)
+{
+    BOFHeader placeholder;
+
+    // an all zero header (without the magic number), so that
+    // if assembly stops with an error, the file is not a BOF file
+    memset(&placeholder, 0, sizeof(placeholder));
+    bof_write_header(bf, placeholder);
+    out = bf;
+    symtab_initialize();
+    text_words = 0;
+    data_words = 0;
+    data_offset = 0;
+    num_fixups = 0;
+    statement_start = arena_mark(&parse_arena);
+    streaming = true;
+    // an error (such as a duplicate label) must not leave part of a program
+    bail_with_error_set_flush(stream_abandon);
+}
+
+// Is single-pass assembly being done?
+bool stream_started()
+{
+    return streaming;
+}
+
+// Free the parse memory of the statement just assembled.
+// (This is called as the parser reduces the statement, whose last
+// token is an eolsym. The parser reduces it without reading the next
+// token, so nothing of the next statement is freed. What the parser
+// still holds, such as the tokens that began the section, is not used
+// any more, except for the names in it, which are interned.)
+static void stream_statement_done()
+{
+    arena_reset(&parse_arena, statement_start);
+}
+
+// Record that the jump with opcode op whose word is at index
+// in the text section should be patched to go to target
+static void stream_add_fixup(unsigned int index, unsigned short op,
+			     lora_t target)
+{
+    if (num_fixups == fixups_capacity) {
+	fixups_capacity = fixups_capacity == 0 ? STREAM_INITIAL_FIXUPS
+	                                       : 2 * fixups_capacity;
+	fixups = (stream_fixup *) realloc(fixups,
+					  fixups_capacity * sizeof(stream_fixup));
+	if (fixups == NULL) {
+	    bail_with_error("Cannot allocate space for %u fixups!",
+			    fixups_capacity);
+	}
+    }
+    fixups[num_fixups].index = index;
+    fixups[num_fixups].op = op;
+    fixups[num_fixups].target = target;
+    num_fixups++;
+}
+
+// Declare asminstr's label (if any) and write its word to the text section
+static void stream_asm_instr(asm_instr_t asminstr)
+{
+    pass1LabelOpt(asminstr.label_opt, text_words);
+
+    instr_t instr = asminstr.instr;
+    if (instr.immed_data.id_data_kind == id_lora
+	&& !instr.immed_data.data.lora.address_defined
+	&& symtab_lookup(instr.immed_data.data.lora.label) == NULL) {
+	// a forward jump: assemble it with address 0 and patch it later
+	stream_add_fixup(text_words, instr.opcode, instr.immed_data.data.lora);
+	instr.immed_data.data.lora.address_defined = true;
+	instr.immed_data.data.lora.addr = 0;
+    }
+    wordAsInstr_t wi;
+    wi.bi = assembleBinInstr(instr);
+    bof_write_word(out, wi.w);
+    text_words++;
+}
+
+// Return an AST for a singleton asm instrs AST with the given
+// instruction; when streaming, the instruction is assembled instead
+// and the list returned has only its length
+asm_instrs_t stream_asm_instrs_singleton(asm_instr_t asminstr)
+{
+    if (!streaming) {
+	return ast_asm_instrs_singleton(asminstr);
+    }
+    asm_instrs_t ret;
+    ret.file_loc = asminstr.file_loc;
+    ret.type_tag = asm_instrs_ast;
+    ret.instrs = NULL;
+    ret.last = NULL;
+    ret.length = 0;
+    return stream_asm_instrs_add(ret, asminstr);
+}
+
+// Return an AST made from adding asminstr to the end of lst;
+// when streaming, asminstr is assembled instead (and lst's length grows)
+asm_instrs_t stream_asm_instrs_add(asm_instrs_t lst, asm_instr_t asminstr)
+{
+    if (!streaming) {
+	return ast_asm_instrs_add(lst, asminstr);
+    }
+    stream_asm_instr(asminstr);
+    stream_statement_done();
+    lst.length++;
+    return lst;
+}
+
+// Return an AST for a list of static declarations
+// with sd added to the end of sds;
+// when streaming, sd is assembled instead (and sds's length grows)
+static_decls_t stream_static_decls_add(static_decls_t sds,
+				       static_decl_t sd)
+{
+    if (!streaming) {
+	return ast_static_decls_add(sds, sd);
+    }
+    // the text section is complete, so the data section follows it
+    pass1Ident(sd.ident, data_offset);
+    data_offset += sd.size_in_bytes;
+    bof_write_word(out, sd.initializer.number);
+    data_words++;
+    stream_statement_done();
+    sds.length++;
+    return sds;
+}
+
+// Patch the jump words in the text section that were assembled
+// before their labels were defined
+static void stream_patch_fixups()
+{
+    for (unsigned int i = 0; i < num_fixups; i++) {
+	lora_t target = fixups[i].target;
+	id_attrs *idap = symtab_lookup(target.label);
+	if (idap == NULL) {
+	    bail_with_error("%s:%u: Label \"%s\" never defined!",
+			    file_location_filename(target.file_loc),
+			    file_location_line(target.file_loc),
+			    target.label);
+	}
+	jump_instr_t ji;
+	ji.op = fixups[i].op;
+	ji.addr = idap->addr;
+	wordAsInstr_t wi;
+	wi.bi = instruction_make_jumpInstr(fixups[i].op, ji);
+	bof_seek(out, sizeof(BOFHeader)
+		 + (long) fixups[i].index * BYTES_PER_WORD);
+	bof_write_word(out, wi.w);
+    }
+}
+
+// Requires: stream_start(bf) was called and prog was then parsed
+// Patch the fixups and the header in bf, whose sections
+// have been written, exiting with an error if a label used
+// was never defined
+void stream_finish(BOFFILE bf, program_t prog)
+{
+    BOFHeader bh;
+    strcpy(bh.magic, "BOF");
+    bh.text_start_address = assemble_lora2address(prog.textSection.entryPoint);
+    stream_patch_fixups();
+    bh.text_length = BYTES_PER_WORD * text_words;
+    bh.data_start_address = prog.dataSection.static_start_addr;
+    bh.data_length = BYTES_PER_WORD * data_words;
+    bh.stack_bottom_addr = prog.stackSection.stack_bottom_addr;
+    bof_seek(bf, 0);
+    bof_write_header(bf, bh);
+    // bf is complete now
+    bail_with_error_set_flush(NULL);
+
+    free(fixups);
+    fixups = NULL;
+    num_fixups = 0;
+    fixups_capacity = 0;
+    streaming = false;
+}
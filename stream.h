@@ -0,0 +1,57 @@
+#ifndef _STREAM_H
+#define _STREAM_H
+#include <stdbool.h>
+#include "ast.h"
+#include "bof.h"
+
+// Single-pass (streaming) assembly.
+// After stream_start, the parser's actions build the text and data
+// sections with the stream_ functions below, which assemble each
+// instruction and static declaration as soon as it is parsed,
+// putting its label or name in the symbol table (as pass1 would)
+// and writing its word to the BOF file, instead of keeping its AST;
+// the parse memory of each statement is then freed.
+// A jump to a label that is not defined yet is assembled with
+// address 0 and recorded as a fixup, which stream_finish patches
+// in the file once the whole program (and so every label) has been seen.
+// So the memory used depends on the number of labels and forward jumps,
+// not on the size of the program.
+// Without stream_start, these functions just build the ASTs.
+
+// Requires: bf is open for writing in binary, to a file (not a pipe)
+// Start single-pass assembly of a program into bf (before parsing it),
+// writing a placeholder header to bf
+// Until stream_finish, an error that exits through bail_with_error
+// calls stream_abandon first.
+extern void stream_start(BOFFILE bf);
+
+// Requires: stream_start(bf) was called, and stream_finish(bf, ...) was not
+// Close and remove bf, so that an error leaves no part of a program
+extern void stream_abandon();
+
+// Is single-pass assembly being done?
+extern bool stream_started();
+
+// Return an AST for a singleton asm instrs AST with the given
+// instruction; when streaming, the instruction is assembled instead
+// and the list returned has only its length
+extern asm_instrs_t stream_asm_instrs_singleton(asm_instr_t asminstr);
+
+// Return an AST made from adding asminstr to the end of lst;
+// when streaming, asminstr is assembled instead (and lst's length grows)
+extern asm_instrs_t stream_asm_instrs_add(asm_instrs_t lst,
+					  asm_instr_t asminstr);
+
+// Return an AST for a list of static declarations
+// with sd added to the end of sds;
+// when streaming, sd is assembled instead (and sds's length grows)
+extern static_decls_t stream_static_decls_add(static_decls_t sds,
+					      static_decl_t sd);
+
+// Requires: stream_start(bf) was called and prog was then parsed
+// Patch the fixups and the header in bf, whose sections
+// have been written, exiting with an error if a label used
+// was never defined
+extern void stream_finish(BOFFILE bf, program_t prog);
+
+#endif
@@ -1,25 +1,72 @@
 /* $Id: symtab.c,v 1.3 2023/09/14 22:29:44 leavens Exp $ */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include "intern.h"
 #include "symtab.h"
 #include "utilities.h"
 
-// For a data structure, we use an array (for now),
-// although a hash table would be better...
+// The entries are kept in an array, in the order they were inserted
+// (which is the order of iteration), and found through an open-addressing
+// hash table (with linear probing) on their names. Both grow as needed.
+// Names from the lexer are interned (see intern.h), so a name found
+// in the table is usually the same pointer as the one looked up.
+
+// The number of entries and of hash table slots the table starts with
+// (the number of slots is a power of 2)
+#define SYMTAB_INITIAL_ENTRIES 64
+#define SYMTAB_INITIAL_SLOTS 128
 
 // size is also the index of the next element to allocate
-static int size;
+static unsigned int size = 0;
 // The data structure is such that the first size entries contain actual data
-static id_attrs entries[MAX_SYMTAB_SIZE];
+static id_attrs *entries = NULL;
+static unsigned int capacity = 0;
+
+// a slot of the hash table: one more than the index of an entry
+// (0 if the slot is empty), and the hash of the entry's name
+typedef struct {
+    unsigned int index;
+    unsigned int hash;
+} symtab_slot;
+static symtab_slot *slots = NULL;
+static unsigned int num_slots = 0;
 
 // The symbol table's invariant
 void symtab_okay()
 {
-    assert(0 <= size);
-    assert(size < MAX_SYMTAB_SIZE);
-    for (int i = size; i < MAX_SYMTAB_SIZE; i++) {
-	assert(entries[i].name == NULL);
+    assert(size <= capacity);
+    assert(2 * size <= num_slots);
+    assert((num_slots & (num_slots - 1)) == 0);
+}
+
+// Put the entry with the given index, whose name's hash is hash,
+// in the first empty slot for it
+static void symtab_place(unsigned int index, unsigned int hash)
+{
+    unsigned int i = hash & (num_slots - 1);
+    while (slots[i].index != 0) {
+	i = (i + 1) & (num_slots - 1);
+    }
+    slots[i].index = index + 1;
+    slots[i].hash = hash;
+}
+
+// Make the hash table twice as big (or give it its first slots),
+// and put the entries back in it
+static void symtab_grow_slots()
+{
+    unsigned int i;
+
+    free(slots);
+    num_slots = num_slots == 0 ? SYMTAB_INITIAL_SLOTS : 2 * num_slots;
+    slots = (symtab_slot *) calloc(num_slots, sizeof(symtab_slot));
+    if (slots == NULL) {
+	bail_with_error("Cannot allocate space for the symtab!");
+    }
+    for (i = 0; i < size; i++) {
+	symtab_place(i, intern_hash(entries[i].name));
     }
 }
 
@@ -27,12 +74,10 @@ void symtab_okay()
 void symtab_initialize()
 {
     size = 0; // no data yet
-    id_attrs none;
-    none.name = NULL;
-    none.file_loc = NULL;
-    none.addr = 0;
-    for (int i = 0; i < MAX_SYMTAB_SIZE; i++) {
-	entries[i] = none;
+    if (slots == NULL) {
+	symtab_grow_slots();
+    } else {
+	memset(slots, 0, num_slots * sizeof(symtab_slot));
     }
     symtab_okay();
 }
@@ -44,8 +89,8 @@ unsigned int symtab_size() { return size; }
 bool symtab_empty() { return size == 0; }
 
 // Is this symbol table full? (I.e., can it not hold more mappings?)
-// (i.e., is symtab_size() equal to MAX_SYMTAB_SIZE-1)?
-bool symtab_full() { return size >= MAX_SYMTAB_SIZE; }
+// It never is, as it grows as needed.
+bool symtab_full() { return false; }
 
 // Is the given name associated with some attributes?
 bool symtab_defined(const char *name)
@@ -54,29 +99,44 @@ bool symtab_defined(const char *name)
     return v != NULL;
 }    
 
-// Requires: !symtab_full
 // Requires: !symtab_defined(attrs.name)
 // Remember the given attributes (i.e., an association from attrs.name
 // to the other parts of attrs)
 void symtab_insert(id_attrs attrs)
 {
-    if (symtab_full()) {
-	bail_with_error("The symtab is full!");
+    if (size == capacity) {
+	capacity = capacity == 0 ? SYMTAB_INITIAL_ENTRIES : 2 * capacity;
+	entries = (id_attrs *) realloc(entries, capacity * sizeof(id_attrs));
+	if (entries == NULL) {
+	    bail_with_error("Cannot allocate space for %u symtab entries!",
+			    capacity);
+	}
+    }
+    entries[size] = attrs;
+    size++;
+    if (2 * size > num_slots) {
+	symtab_grow_slots();
+    } else {
+	symtab_place(size - 1, intern_hash(attrs.name));
     }
-    entries[size++] = attrs;
 }
 
 // if name == NULL or if name is not defined, return -1
 // if name is defined in the table, return its index
 static int find_index(const char *name)
 {
-    if (name == NULL) {
+    if (name == NULL || num_slots == 0) {
 	return -1;
     }
-    for (int i = 0; i < size; i++) {
-	if (strcmp(entries[i].name, name) == 0) {
-	    return i;
+    unsigned int hash = intern_hash(name);
+    unsigned int i = hash & (num_slots - 1);
+    while (slots[i].index != 0) {
+	const char *found = entries[slots[i].index - 1].name;
+	if (slots[i].hash == hash
+	    && (found == name || strcmp(found, name) == 0)) {
+	    return slots[i].index - 1;
 	}
+	i = (i + 1) & (num_slots - 1);
     }
     return -1;
 }
@@ -114,7 +174,7 @@ const char *symtab_first_name()
 bool symtab_more_after(const char *name)
 {
     int i = find_index(name);
-    return (0 <= i && i < size);
+    return 0 <= i;
 }
 
 // Requires: symtab_more_after(name);
@@ -123,7 +183,7 @@ bool symtab_more_after(const char *name)
 const char *symtab_next_name(const char *name)
 {
     int i = find_index(name);
-    if (i < 0 || i >= size) {
+    if (i < 0 || i + 1 >= size) {
 	return NULL;
     } else {
 	return entries[i+1].name;
@@ -5,9 +5,6 @@
 #include <stdbool.h>
 #include "id_attrs.h"
 
-// Maximum number of names/attributes that can be stored in a symboltable
-#define MAX_SYMTAB_SIZE 1024
-
 // initialize the symbol table
 extern void symtab_initialize();
 
@@ -18,7 +15,7 @@ extern unsigned int symtab_size();
 extern bool symtab_empty();
 
 // Is this symbol table full? (I.e., can it not hold more mappings?)
-// (i.e., is symtab_size() equal to MAX_SYMTAB_SIZE-1)?
+// It never is, as it grows as needed.
 extern bool symtab_full();
 
 // Is the given name associated with some attributes?
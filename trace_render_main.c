@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bof.h"
+#include "instruction.h"
+#include "utilities.h"
+#include "tracebuf.h"
+#include "bintrace.h"
+#include "machine.h"
+
+// Print a usage message on stderr and exit with a failure code
+static void usage(const char *cmdname) {
+    bail_with_error("Usage: %s trace.btr", cmdname);
+}
+
+// the VM whose state the trace rebuilds
+static vm_state *vm;
+
+// Write out the VM's buffered trace output
+static void flush_vm_output() {
+    vm_flush_output(vm);
+}
+
+// Render a binary trace written by vm -b as the text trace the VM
+// would have printed, but without the program's own output.
+int main(int argc, char **argv) {
+    BOFFILE trace_file;
+    bintrace_change change;
+    word_type instr;
+    wordAsInstr_t w;
+
+    if (argc != 2) {
+        usage(argv[0]);
+    }
+
+    trace_file = bof_read_open(argv[1]);
+    vm = vm_create(stdin, stdout);
+    vm->exit_on_error = 1;
+    bail_with_error_set_flush(flush_vm_output);
+    vm->bof_header = bintrace_read_header(trace_file);
+
+    // The new VM starts out all zero, as the VM's record of the last
+    // step written does, so applying each step's changes rebuilds its state.
+    while (bintrace_read_step(trace_file, &vm->PC, &instr)) {
+        while (bintrace_read_change(trace_file, &change)) {
+            if (change.tag == BINTRACE_WORD) {
+                if (change.index >= MEMORY_SIZE_IN_WORDS) {
+                    bail_with_error("Bad memory word index (%d) in binary trace %s",
+                                    change.index, trace_file.filename);
+                }
+                vm->memory.words[change.index] = change.value;
+            } else if (change.tag == BINTRACE_HI) {
+                vm->HI = change.value;
+            } else if (change.tag == BINTRACE_LO) {
+                vm->LO = change.value;
+            } else {
+                vm->GPR[change.tag] = change.value;
+            }
+        }
+        w.w = instr;
+        print_trace_step(vm, w.bi);
+    }
+
+    bof_close(trace_file);
+    vm_destroy(vm);
+    return 0;
+}
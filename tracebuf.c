@@ -0,0 +1,149 @@
+// for fileno
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "utilities.h"
+#include "tracebuf.h"
+
+// Longest decimal form of an int, with its sign
+#define INT_DIGITS 11
+
+// Make tb an empty buffer for text going to out
+void tracebuf_init(tracebuf_t *tb, FILE *out) {
+    tb->out = out;
+    tb->fd = -1;
+    tb->used = 0;
+}
+
+// Write the buffer to out's file descriptor with write(2) from now on
+// (if out has a file descriptor)
+void tracebuf_write_directly(tracebuf_t *tb) {
+    tracebuf_flush(tb);
+    fflush(tb->out);
+    tb->fd = fileno(tb->out);
+}
+
+// Write the n chars starting at s to the output file
+static void tracebuf_emit(tracebuf_t *tb, const char *s, size_t n) {
+    ssize_t written;
+
+    if (tb->fd < 0) {
+        if (fwrite(s, 1, n, tb->out) != n) {
+            bail_with_error("Cannot write trace output");
+        }
+        return;
+    }
+    // anything written to out through stdio has to come first
+    fflush(tb->out);
+    while (n > 0) {
+        written = write(tb->fd, s, n);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            bail_with_error("Cannot write trace output");
+        }
+        s += written;
+        n -= written;
+    }
+}
+
+// Make room for n more chars in tb's buffer, writing out what is there if needed
+static void tracebuf_reserve(tracebuf_t *tb, size_t n) {
+    if (tb->used + n > TRACEBUF_SIZE) {
+        tracebuf_flush(tb);
+    }
+}
+
+// Append the n chars starting at s
+void tracebuf_put_bytes(tracebuf_t *tb, const char *s, size_t n) {
+    if (n > TRACEBUF_SIZE) {
+        tracebuf_flush(tb);
+        tracebuf_emit(tb, s, n);
+        return;
+    }
+    tracebuf_reserve(tb, n);
+    memcpy(tb->buf + tb->used, s, n);
+    tb->used += n;
+}
+
+// Append n spaces
+static void tracebuf_pad(tracebuf_t *tb, int n) {
+    if (n <= 0) {
+        return;
+    }
+    tracebuf_reserve(tb, n);
+    memset(tb->buf + tb->used, ' ', n);
+    tb->used += n;
+}
+
+// Format n in decimal at the end of digits (which has INT_DIGITS chars),
+// returning the number of chars used
+static int tracebuf_format_int(int n, char digits[INT_DIGITS]) {
+    // work with the magnitude as unsigned, so INT_MIN is fine
+    unsigned int u = n < 0 ? 0u - (unsigned int) n : (unsigned int) n;
+    int i = INT_DIGITS;
+
+    do {
+        digits[--i] = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (n < 0) {
+        digits[--i] = '-';
+    }
+    return INT_DIGITS - i;
+}
+
+// Append the string s
+void tracebuf_puts(tracebuf_t *tb, const char *s) {
+    tracebuf_put_bytes(tb, s, strlen(s));
+}
+
+// Append the string s, padded with spaces on the right to width chars
+void tracebuf_puts_left(tracebuf_t *tb, const char *s, int width) {
+    size_t len = strlen(s);
+    tracebuf_put_bytes(tb, s, len);
+    tracebuf_pad(tb, width - (int) len);
+}
+
+// Append the character c
+void tracebuf_putc(tracebuf_t *tb, char c) {
+    tracebuf_reserve(tb, 1);
+    tb->buf[tb->used++] = c;
+}
+
+// Append the decimal form of n
+void tracebuf_put_int(tracebuf_t *tb, int n) {
+    char digits[INT_DIGITS];
+    int len = tracebuf_format_int(n, digits);
+    tracebuf_put_bytes(tb, digits + INT_DIGITS - len, len);
+}
+
+// Append the decimal form of n, padded with spaces on the right to width chars
+void tracebuf_put_int_left(tracebuf_t *tb, int n, int width) {
+    char digits[INT_DIGITS];
+    int len = tracebuf_format_int(n, digits);
+    tracebuf_put_bytes(tb, digits + INT_DIGITS - len, len);
+    tracebuf_pad(tb, width - len);
+}
+
+// Append the decimal form of n, padded with spaces on the left to width chars
+void tracebuf_put_int_right(tracebuf_t *tb, int n, int width) {
+    char digits[INT_DIGITS];
+    int len = tracebuf_format_int(n, digits);
+    tracebuf_pad(tb, width - len);
+    tracebuf_put_bytes(tb, digits + INT_DIGITS - len, len);
+}
+
+// Hand the buffered text to the output file, so that it comes before
+// anything written to that file afterwards
+void tracebuf_flush(tracebuf_t *tb) {
+    size_t n = tb->used;
+
+    if (n == 0) {
+        return;
+    }
+    tb->used = 0;
+    tracebuf_emit(tb, tb->buf, n);
+}
@@ -0,0 +1,62 @@
+#ifndef _TRACEBUF_H
+#define _TRACEBUF_H
+
+#include <stdio.h>
+
+// A buffered writer for the VM's output: its trace, and what the program
+// prints with PCH and PSTR, which go through the same buffer so they stay
+// in order. Text is formatted into one large buffer (integers without printf)
+// and handed to the output file with a single fwrite (or, after
+// tracebuf_write_directly, a write(2) that bypasses stdio) when the buffer
+// fills up or when tracebuf_flush is called. Anything else that writes
+// to the same file (or to stderr) must call tracebuf_flush first
+// to keep the order.
+
+// Size of the buffer in bytes
+#define TRACEBUF_SIZE (256 * 1024)
+
+// A trace buffer and the file its text goes to
+typedef struct {
+    FILE *out;
+    int fd;        // out's file descriptor, if written with write(2), else -1
+    size_t used;   // number of chars in buf that have not yet been written
+    char buf[TRACEBUF_SIZE];
+} tracebuf_t;
+
+// Make tb an empty buffer for text going to out
+extern void tracebuf_init(tracebuf_t *tb, FILE *out);
+
+// Write the buffer to out's file descriptor with write(2) from now on,
+// instead of through out's stdio buffer (if out has a file descriptor)
+extern void tracebuf_write_directly(tracebuf_t *tb);
+
+// Append the n chars starting at s
+extern void tracebuf_put_bytes(tracebuf_t *tb, const char *s, size_t n);
+
+// Append the string s
+extern void tracebuf_puts(tracebuf_t *tb, const char *s);
+
+// Append the string s, padded with spaces on the right to width chars
+// (like printf's "%-*s")
+extern void tracebuf_puts_left(tracebuf_t *tb, const char *s, int width);
+
+// Append the character c
+extern void tracebuf_putc(tracebuf_t *tb, char c);
+
+// Append the decimal form of n (like printf's "%d")
+extern void tracebuf_put_int(tracebuf_t *tb, int n);
+
+// Append the decimal form of n, padded with spaces on the right
+// to width chars (like printf's "%-*d")
+extern void tracebuf_put_int_left(tracebuf_t *tb, int n, int width);
+
+// Append the decimal form of n, padded with spaces on the left
+// to width chars (like printf's "%*d")
+extern void tracebuf_put_int_right(tracebuf_t *tb, int n, int width);
+
+// Hand the buffered text to the output file, so that it comes before
+// anything written to that file afterwards
+// (when writing directly, it is in the file once this returns)
+extern void tracebuf_flush(tracebuf_t *tb);
+
+#endif
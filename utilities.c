@@ -42,11 +42,29 @@ static void vdebug_print(const char *fmt, va_list args)
 
 static void vbail_with_error(const char* fmt, va_list args);
 
+// called by bail_with_error before anything else, if not NULL
+static void (*bail_flush)(void) = NULL;
+
+// Requires: flush can be called at any time before the program exits
+// Make bail_with_error call flush before it prints its message,
+// so that output buffered outside of stdio comes before the message.
+void bail_with_error_set_flush(void (*flush)(void))
+{
+    bail_flush = flush;
+}
+
 // Format a string error message and print it followed by a newline on stderr
 // using perror (for an OS error, if the errno is not 0)
 // then exit with a failure code, so a call to this does not return.
 void bail_with_error(const char *fmt, ...)
 {
+    if (bail_flush != NULL) {
+	void (*flush)(void) = bail_flush;
+	int saved_errno = errno; // the message may depend on errno
+	bail_flush = NULL; // in case flush itself bails
+	flush();
+	errno = saved_errno;
+    }
     fflush(stdout); // flush so output comes after what has happened already
     va_list(args);
     va_start(args, fmt);
@@ -15,6 +15,11 @@ void debug_print(const char *fmt, ...);
 // then exit with a failure code, so a call to this does not return.
 extern void bail_with_error(const char *fmt, ...);
 
+// Requires: flush can be called at any time before the program exits
+// Make bail_with_error call flush before it prints its message,
+// so that output buffered outside of stdio comes before the message.
+extern void bail_with_error_set_flush(void (*flush)(void));
+
 // print a newline on out and flush out
 extern void newline(FILE *out);
 
@@ -0,0 +1,260 @@
+// for open_memstream and sysconf
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bof.h"
+#include "utilities.h"
+#include "machine.h"
+
+// The most worker threads vm-batch will start
+#define MAX_WORKERS 256
+
+static const char *cmdname;
+
+// One program of the batch and what happened when it ran
+typedef struct {
+    const char *filename;
+    // the loaded program, which the job's VM is forked from (NULL if it
+    // could not be loaded), shared by all the jobs that run the same file
+    vm_state *base;
+    int owns_base;           // is this the first job with base?
+    vm_status status;
+    char error_message[VM_ERROR_MESSAGE_SIZE];
+    unsigned long long instruction_count;
+    char *output;            // everything the program wrote (and its error)
+    size_t output_size;
+} batch_job;
+
+// The batch, shared by the workers, which take the jobs in order
+static batch_job *jobs;
+static int num_jobs;
+static int next_job = 0;
+static pthread_mutex_t next_job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the options every program runs with
+static engine_type engine = engine_decoded;
+static int fast_mode = 0;
+
+// Print a usage message on stderr and exit with a failure code
+static void usage() {
+    bail_with_error("Usage: %s [-j threads] [-f] [-e switch|decoded|threaded|jit] [-o ext] file.bof ...",
+                    cmdname);
+}
+
+// Load the program of jobs[j] as its base, unless an earlier job
+// runs the same file, in which case share that job's base.
+// (A file that cannot be loaded fails its jobs, but not the others.)
+static void load_base(int j) {
+    batch_job *job = &jobs[j];
+    int k;
+
+    for (k = 0; k < j; k++) {
+        if (strcmp(jobs[k].filename, job->filename) == 0) {
+            job->base = jobs[k].base;
+            job->status = jobs[k].status;
+            strcpy(job->error_message, jobs[k].error_message);
+            return;
+        }
+    }
+
+    // the base never runs, so it needs no input or output of its own
+    job->base = vm_create(stdin, stdout);
+    job->owns_base = 1;
+    job->base->engine = engine;
+    job->base->fast_mode = fast_mode;
+    if (vm_load(job->base, job->filename) == vm_running) {
+        vm_share(job->base);
+    } else {
+        job->status = job->base->status;
+        strcpy(job->error_message, job->base->error_message);
+    }
+}
+
+// Run the program of job in a VM of its own, forked from the job's base,
+// reading an empty input, and record its status, instruction count,
+// and output in job.
+// As with vm, an error message comes after the program's output.
+static void run_job(batch_job *job) {
+    FILE *in = fopen("/dev/null", "r");
+    FILE *out = open_memstream(&job->output, &job->output_size);
+    vm_state *vm;
+
+    if (in == NULL || out == NULL) {
+        bail_with_error("Cannot open the input or output for %s", job->filename);
+    }
+    if (job->base == NULL || job->base->status != vm_running) {
+        // the program could not be loaded
+        fprintf(out, "%s\n", job->error_message);
+        fclose(out);
+        fclose(in);
+        return;
+    }
+
+    vm = vm_fork(job->base, in, out);
+    vm_run(vm);
+    vm_flush_output(vm);
+    if (vm->status == vm_failed) {
+        fprintf(out, "%s\n", vm->error_message);
+    }
+
+    job->status = vm->status;
+    strcpy(job->error_message, vm->error_message);
+    job->instruction_count = vm->instruction_count;
+    vm_destroy(vm);
+    fclose(out);
+    fclose(in);
+}
+
+// Run jobs until there are none left
+static void *worker(void *unused) {
+    int j;
+
+    for (;;) {
+        pthread_mutex_lock(&next_job_lock);
+        j = next_job++;
+        pthread_mutex_unlock(&next_job_lock);
+        if (j >= num_jobs)
+            return NULL;
+        run_job(&jobs[j]);
+    }
+}
+
+// Write the output of job to its file name with the .bof suffix
+// (if any) replaced by .ext
+static void write_output(const batch_job *job, const char *ext) {
+    size_t len = strlen(job->filename);
+    char *name;
+    FILE *f;
+
+    if (len >= 4 && strcmp(job->filename + len - 4, ".bof") == 0)
+        len -= 4;
+    name = malloc(len + strlen(ext) + 2);
+    if (name == NULL) {
+        bail_with_error("Cannot allocate space for an output file name");
+    }
+    sprintf(name, "%.*s.%s", (int) len, job->filename, ext);
+    f = fopen(name, "w");
+    if (f == NULL) {
+        bail_with_error("Cannot open %s", name);
+    }
+    fwrite(job->output, 1, job->output_size, f);
+    fclose(f);
+    free(name);
+}
+
+// Print one line saying how job ended
+static void report(const batch_job *job) {
+    static const char *status_names[] = {
+        [vm_running] = "running", [vm_exited] = "exited",
+        [vm_halted] = "halted", [vm_failed] = "failed"
+    };
+
+    printf("%s: %s after %llu instructions, %zu bytes of output",
+           job->filename, status_names[job->status],
+           job->instruction_count, job->output_size);
+    if (job->status == vm_failed)
+        printf(": %s", job->error_message);
+    printf("\n");
+}
+
+// Run each of the BOF files named on the command line in a VM of its own,
+// on a pool of worker threads, then report how each one ended
+// (and with -o, write its output to a file with the extension ext).
+// Each file is loaded once; when it is named more than once,
+// the VMs that run it share its memory until they write to it.
+// A program that fails only fails its own job, but then
+// the exit code says that some job failed.
+int main(int argc, char **argv) {
+    int num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *output_ext = NULL;
+    pthread_t workers[MAX_WORKERS];
+    int any_failed = 0;
+    int i;
+
+    cmdname = argv[0];
+    argc--;
+    argv++;
+
+    // Process the options: -j threads, -f, -e engine, and -o ext.
+    while (argc > 0 && strlen(argv[0]) >= 2 && argv[0][0] == '-') {
+        if (strcmp(argv[0], "-j") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            num_workers = atoi(argv[0]);
+            if (num_workers < 1)
+                usage();
+        } else if (strcmp(argv[0], "-f") == 0) {
+            fast_mode = 1;
+        } else if (strcmp(argv[0], "-e") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            if (strcmp(argv[0], "switch") == 0)
+                engine = engine_switch;
+            else if (strcmp(argv[0], "decoded") == 0)
+                engine = engine_decoded;
+            else if (strcmp(argv[0], "threaded") == 0)
+                engine = engine_threaded;
+            else if (strcmp(argv[0], "jit") == 0)
+                engine = engine_jit;
+            else
+                usage();
+        } else if (strcmp(argv[0], "-o") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            output_ext = argv[0];
+        } else {
+            usage();
+        }
+        argc--;
+        argv++;
+    }
+    if (argc < 1) {
+        usage();
+    }
+
+    num_jobs = argc;
+    jobs = calloc(num_jobs, sizeof(batch_job));
+    if (jobs == NULL) {
+        bail_with_error("Cannot allocate space for %d jobs", num_jobs);
+    }
+    for (i = 0; i < num_jobs; i++) {
+        jobs[i].filename = argv[i];
+    }
+    for (i = 0; i < num_jobs; i++) {
+        load_base(i);
+    }
+
+    if (num_workers < 1)
+        num_workers = 1;
+    if (num_workers > MAX_WORKERS)
+        num_workers = MAX_WORKERS;
+    if (num_workers > num_jobs)
+        num_workers = num_jobs;
+    for (i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[i], NULL, worker, NULL) != 0) {
+            bail_with_error("Cannot start worker thread %d", i);
+        }
+    }
+    for (i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    // Report in the order the files were given, whatever order they ran in.
+    for (i = 0; i < num_jobs; i++) {
+        if (output_ext != NULL)
+            write_output(&jobs[i], output_ext);
+        report(&jobs[i]);
+        if (jobs[i].status == vm_failed)
+            any_failed = 1;
+        free(jobs[i].output);
+    }
+    for (i = 0; i < num_jobs; i++) {
+        if (jobs[i].owns_base)
+            vm_destroy(jobs[i].base);
+    }
+    free(jobs);
+    return any_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+// for open_memstream
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bof.h"
+#include "utilities.h"
+#include "machine.h"
+
+// The number of engines there are (see engine_type)
+#define NUM_ENGINES 4
+
+static const char *cmdname;
+
+static const char *engine_names[NUM_ENGINES] = {
+    [engine_switch] = "switch", [engine_decoded] = "decoded",
+    [engine_threaded] = "threaded", [engine_jit] = "jit"
+};
+
+// One run of a benchmark: how it ended, what it did, and how long it took
+typedef struct {
+    vm_status status;
+    char error_message[VM_ERROR_MESSAGE_SIZE];
+    unsigned long long instruction_count;
+    double seconds;
+    char *output;            // everything the program wrote
+    size_t output_size;
+} bench_run;
+
+// Print a usage message on stderr and exit with a failure code
+static void usage() {
+    bail_with_error("Usage: %s [-r repeats] [-f] [-e switch|decoded|threaded|jit] ... file.bof ...",
+                    cmdname);
+}
+
+// Run the program in filename once with engine, with tracing off
+// and an empty input, and record how it went in run
+static void run_once(const char *filename, engine_type engine, int fast_mode, bench_run *run) {
+    FILE *in = fopen("/dev/null", "r");
+    FILE *out = open_memstream(&run->output, &run->output_size);
+    vm_state *vm;
+
+    if (in == NULL || out == NULL) {
+        bail_with_error("Cannot open the input or output for %s", filename);
+    }
+    vm = vm_create(in, out);
+    vm->engine = engine;
+    vm->fast_mode = fast_mode;
+
+    if (vm_load(vm, filename) == vm_running) {
+        vm->trace = 0;  // NOTR before the first instruction
+        vm_run(vm);
+    }
+    vm_flush_output(vm);
+
+    run->status = vm->status;
+    strcpy(run->error_message, vm->error_message);
+    run->instruction_count = vm->instruction_count;
+    run->seconds = vm_run_seconds(vm);
+    vm_destroy(vm);
+    fclose(out);
+    fclose(in);
+}
+
+// Run the program in filename repeats times with engine, and put the
+// fastest run in best. Return 1 if every run ended the same way as best.
+static int run_bench(const char *filename, engine_type engine, int fast_mode,
+                     int repeats, bench_run *best) {
+    bench_run run;
+    int same = 1;
+    int r;
+
+    run_once(filename, engine, fast_mode, best);
+    for (r = 1; r < repeats; r++) {
+        run_once(filename, engine, fast_mode, &run);
+        if (run.status != best->status || run.instruction_count != best->instruction_count
+            || run.output_size != best->output_size
+            || memcmp(run.output, best->output, run.output_size) != 0)
+            same = 0;
+        if (run.seconds < best->seconds) {
+            free(best->output);
+            *best = run;
+        } else {
+            free(run.output);
+        }
+    }
+    return same;
+}
+
+// Run each of the BOF files named on the command line with each engine
+// (or those chosen with -e), taking the fastest of several runs,
+// and print the instructions each executed per second.
+// Exit with a failure code if a program fails, or if the engines
+// disagree on its instruction count or output.
+int main(int argc, char **argv) {
+    int use_engine[NUM_ENGINES] = {0};
+    int engines_chosen = 0;
+    int repeats = 3;
+    int fast_mode = 0;
+    int failures = 0;
+    bench_run reference, run;
+    int have_reference;
+    const char *problem;
+    int i, e;
+
+    cmdname = argv[0];
+    argc--;
+    argv++;
+
+    // Process the options: -r repeats, -f, and -e engine (which can be repeated).
+    while (argc > 0 && strlen(argv[0]) >= 2 && argv[0][0] == '-') {
+        if (strcmp(argv[0], "-r") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            repeats = atoi(argv[0]);
+            if (repeats < 1)
+                usage();
+        } else if (strcmp(argv[0], "-f") == 0) {
+            fast_mode = 1;
+        } else if (strcmp(argv[0], "-e") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            for (e = 0; e < NUM_ENGINES; e++) {
+                if (strcmp(argv[0], engine_names[e]) == 0)
+                    break;
+            }
+            if (e == NUM_ENGINES)
+                usage();
+            use_engine[e] = 1;
+            engines_chosen = 1;
+        } else {
+            usage();
+        }
+        argc--;
+        argv++;
+    }
+    if (argc < 1) {
+        usage();
+    }
+    if (!engines_chosen) {
+        for (e = 0; e < NUM_ENGINES; e++)
+            use_engine[e] = 1;
+    }
+
+    printf("%-24s %-9s %12s %10s %10s\n", "Benchmark", "Engine", "Instructions",
+           "Seconds", "MIPS");
+    for (i = 0; i < argc; i++) {
+        have_reference = 0;
+        for (e = 0; e < NUM_ENGINES; e++) {
+            if (!use_engine[e])
+                continue;
+            problem = NULL;
+            if (!run_bench(argv[i], e, fast_mode, repeats, &run))
+                problem = "runs differ";
+            if (run.status == vm_failed)
+                problem = run.error_message;
+            else if (run.status == vm_running)
+                problem = "did not finish";
+            // the first engine's run is what the others have to match
+            if (!have_reference) {
+                reference = run;
+                have_reference = 1;
+            } else if (run.instruction_count != reference.instruction_count
+                       || run.output_size != reference.output_size
+                       || memcmp(run.output, reference.output, run.output_size) != 0) {
+                problem = "differs from the first engine";
+            }
+
+            printf("%-24s %-9s %12llu %10.4f %10.1f", argv[i], engine_names[e],
+                   run.instruction_count, run.seconds,
+                   run.seconds > 0 ? run.instruction_count / run.seconds / 1e6 : 0.0);
+            if (problem != NULL) {
+                printf("  %s", problem);
+                failures++;
+            }
+            printf("\n");
+            fflush(stdout);
+            if (run.output != reference.output)
+                free(run.output);
+        }
+        if (have_reference)
+            free(reference.output);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
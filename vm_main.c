@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bof.h"
+#include "utilities.h"
+#include "machine.h"
+
+static const char *cmdname;
+
+// the VM this program runs
+static vm_state *vm;
+
+// the BOF file it runs, and where -stats writes the run's summary
+// (NULL for no summary, "-" for stderr)
+static const char *program_name;
+static const char *summary_name = NULL;
+
+// Write the summary of the VM's run to summary_name
+static void write_summary() {
+    FILE *out = stderr;
+
+    if (strcmp(summary_name, "-") != 0) {
+        out = fopen(summary_name, "w");
+        if (out == NULL) {
+            const char *name = summary_name;
+            summary_name = NULL;  // so the error does not try again
+            bail_with_error("Cannot open %s for the summary", name);
+        }
+    }
+    vm_write_summary(vm, program_name, out);
+    if (out != stderr)
+        fclose(out);
+}
+
+// Write out the VM's buffered trace output (and, if the VM failed
+// and there is to be one, the summary of its run)
+static void flush_vm_output() {
+    vm_flush_output(vm);
+    if (vm->status == vm_failed && summary_name != NULL)
+        write_summary();
+}
+
+// Print a usage message on stderr and exit with a failure code
+static void usage() {
+    bail_with_error("Usage: %s [-f] [-e switch|decoded|threaded|jit] [-prof] [-stats file|-] [-w]\n"
+                    "          [-checkpoint count file.snp | -snapshot count file.snp]\n"
+                    "          [-record file.iol | -replay file.iol]\n"
+                    "          [-d | -b trace.btr] file.bof\n"
+                    "       %s [options] -resume file.snp\n"
+                    "       %s -p file.bof", cmdname, cmdname, cmdname);
+}
+
+// Define the main function to execute the virtual machine.
+int main(int argc, char **argv) {
+    int print_program = 0;
+    int profiling = 0;
+    int write_directly = 0;
+    const char *binary_trace_name = NULL;
+    int resuming = 0;
+    unsigned long long checkpoint_every = 0;
+    int snapshot_only = 0;
+    const char *snapshot_name = NULL;
+    const char *record_name = NULL;
+    const char *replay_name = NULL;
+
+    cmdname = argv[0];
+    argc--;
+    argv++;
+
+    // The VM reads stdin and writes stdout, and its errors end this program.
+    vm = vm_create(stdin, stdout);
+    vm->exit_on_error = 1;
+
+    // Process the options: -p, -f, -e engine, -prof, -stats file, -w,
+    // -checkpoint count file, -snapshot count file, -resume, -record file,
+    // -replay file, -d, and -b trace file.
+    while (argc > 0 && strlen(argv[0]) >= 2 && argv[0][0] == '-') {
+        if (strcmp(argv[0], "-p") == 0) {
+            print_program = 1;
+        } else if (strcmp(argv[0], "-f") == 0) {
+            vm->fast_mode = 1;
+        } else if (strcmp(argv[0], "-e") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            if (strcmp(argv[0], "switch") == 0)
+                vm->engine = engine_switch;
+            else if (strcmp(argv[0], "decoded") == 0)
+                vm->engine = engine_decoded;
+            else if (strcmp(argv[0], "threaded") == 0)
+                vm->engine = engine_threaded;
+            else if (strcmp(argv[0], "jit") == 0)
+                vm->engine = engine_jit;
+            else
+                usage();
+        } else if (strcmp(argv[0], "-prof") == 0) {
+            profiling = 1;
+        } else if (strcmp(argv[0], "-stats") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            summary_name = argv[0];
+        } else if (strcmp(argv[0], "-w") == 0) {
+            write_directly = 1;
+        } else if ((strcmp(argv[0], "-checkpoint") == 0 || strcmp(argv[0], "-snapshot") == 0)
+                   && argc > 2) {
+            snapshot_only = strcmp(argv[0], "-snapshot") == 0;
+            checkpoint_every = strtoull(argv[1], NULL, 10);
+            snapshot_name = argv[2];
+            if (checkpoint_every == 0)
+                usage();
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(argv[0], "-resume") == 0) {
+            resuming = 1;
+        } else if (strcmp(argv[0], "-record") == 0 && argc > 1 && replay_name == NULL) {
+            argc--;
+            argv++;
+            record_name = argv[0];
+        } else if (strcmp(argv[0], "-replay") == 0 && argc > 1 && record_name == NULL) {
+            argc--;
+            argv++;
+            replay_name = argv[0];
+        } else if (strcmp(argv[0], "-d") == 0) {
+            vm->delta_trace = 1;
+        } else if (strcmp(argv[0], "-b") == 0 && argc > 1) {
+            argc--;
+            argv++;
+            binary_trace_name = argv[0];
+        } else {
+            usage();
+        }
+        argc--;
+        argv++;
+    }
+
+    // Check for the BOF file name argument.
+    if (argc != 1) {
+        fprintf(stderr, "Missing arguments\n");
+        exit(0);
+    }
+
+    // Load the BOF file and set initial register values,
+    // or, with -resume, pick up where the snapshot in the file left off.
+    program_name = argv[0];
+    if (resuming)
+        vm_resume(vm, program_name);
+    else
+        vm_load(vm, program_name);
+
+    // Trace output is buffered, so it must be written out before any error message.
+    bail_with_error_set_flush(flush_vm_output);
+
+    // If the program is run with -p flag, print the assembly instructions and data sections.
+    if (print_program) {
+        print_instruction_section(vm);
+        print_data_section(vm);
+        vm_destroy(vm);
+        return 0;
+    }
+
+    // With -w, the program's output and trace bypass stdout's buffer
+    // and go to its file descriptor with write(2).
+    if (write_directly)
+        tracebuf_write_directly(&vm->tracebuf);
+
+    // With -b, traced steps go to the binary trace file instead of stdout.
+    if (binary_trace_name != NULL)
+        vm_write_binary_trace(vm, binary_trace_name);
+
+    // With -record, log the program's input and output as it runs;
+    // with -replay, take its input from such a log instead of stdin.
+    if (record_name != NULL)
+        vm_record_io(vm, record_name);
+    else if (replay_name != NULL)
+        vm_replay_io(vm, replay_name);
+
+    // With -prof, count what runs, and report it on stderr at the end.
+    if (profiling)
+        vm->profile = profile_create(vm->predecoded_length);
+
+    // With -checkpoint, stop every checkpoint_every instructions (or a few more)
+    // to write a snapshot; with -snapshot, stop for that the first time only.
+    if (checkpoint_every > 0) {
+        vm->stop_count = vm->instruction_count + checkpoint_every;
+        while (vm_run(vm) == vm_running) {
+            vm_write_snapshot(vm, snapshot_name);
+            if (snapshot_only)
+                break;
+            vm->stop_count = vm->instruction_count + checkpoint_every;
+        }
+    } else {
+        vm_run(vm);
+    }
+
+    if (profiling) {
+        vm_flush_output(vm);
+        fflush(stdout);
+        profile_report(vm->profile, vm->memory.instrs, stderr);
+    }
+
+    // With -stats, write the run's counts and time as JSON.
+    if (summary_name != NULL)
+        write_summary();
+
+    vm_destroy(vm);
+    return 0;
+}